@@ -17,6 +17,9 @@
 #include <iostream>
 #include <iomanip>
 #include <chrono>
+#include "../../common/ProgramBinaryCache.h"
+#include "../../common/KernelSource.h"
+#include "HadamardProduct.embedded.h"
 
 #define RAND_BASE 10
 #define LENGTH 819200
@@ -294,15 +297,10 @@ int Program(int argc, char* argv[])
 	vector<cl::Device> devices = context.getInfo<CL_CONTEXT_DEVICES>();
 	cl::Device device = devices[0];
 
-	// Read source file
-	ifstream sourceFile("HadamardProduct.cl");
-	string kernelSource(
-		istreambuf_iterator<char>(sourceFile),
-		(istreambuf_iterator<char>()));
-	cl::Program::Sources source{ kernelSource };
-	cl::Program program = cl::Program(context, source);
-	// Build binary version of program.
-	program.build(device);
+	string kernelSource = LoadKernelSource("HadamardProduct.cl", embeddedKernelSource);
+	// Build binary version of program from SPIR-V compiled offline or from source, unless previous run cached it.
+	cl::Program program;
+	BuildProgramCached(program, context, device, kernelSource, "", KernelILPath("HadamardProduct.spv"));
 
 	cout << "\n";
 
@@ -10,6 +10,9 @@
 #include <chrono>
 #include "../common/utils.h"
 #include "../common/CImg.h"
+#include "../../common/ProgramBinaryCache.h"
+#include "../../common/KernelSource.h"
+#include "ImageFilters.embedded.h"
 
 #define VERBOSE true
 
@@ -110,15 +113,10 @@ int Program(int argc, char* argv[])
 	cl::Device device = devices[0];
 	cl::CommandQueue commandQueue(context, device, cl::QueueProperties::Profiling);
 
-	// Read source file
-	ifstream sourceFile("ImageFilters.cl");
-	string kernelSource(
-		istreambuf_iterator<char>(sourceFile),
-		(istreambuf_iterator<char>()));
-	cl::Program::Sources source{ kernelSource };
-	cl::Program program = cl::Program(context, source);
-	// Build binary version of program.
-	program.build(device);
+	string kernelSource = LoadKernelSource("ImageFilters.cl", embeddedKernelSource);
+	// Build binary version of program from SPIR-V compiled offline or from source, unless previous run cached it.
+	cl::Program program;
+	BuildProgramCached(program, context, device, kernelSource, "", KernelILPath("ImageFilters.spv"));
 
 	cout << "\n\nImage filters\n";
 
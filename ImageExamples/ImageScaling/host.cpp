@@ -10,6 +10,9 @@
 #include <chrono>
 #include "../common/utils.h"
 #include "../common/CImg.h"
+#include "../../common/ProgramBinaryCache.h"
+#include "../../common/KernelSource.h"
+#include "ImageScaling.embedded.h"
 
 #define VERBOSE true
 
@@ -91,15 +94,10 @@ int Program(int argc, char* argv[])
 	cl::Device device = devices[0];
 	cl::CommandQueue commandQueue(context, device, cl::QueueProperties::Profiling);
 
-	// Read source file
-	ifstream sourceFile("ImageScaling.cl");
-	string kernelSource(
-		istreambuf_iterator<char>(sourceFile),
-		(istreambuf_iterator<char>()));
-	cl::Program::Sources source{ kernelSource };
-	cl::Program program = cl::Program(context, source);
-	// Build binary version of program.
-	program.build(device);
+	string kernelSource = LoadKernelSource("ImageScaling.cl", embeddedKernelSource);
+	// Build binary version of program from SPIR-V compiled offline or from source, unless previous run cached it.
+	cl::Program program;
+	BuildProgramCached(program, context, device, kernelSource, "", KernelILPath("ImageScaling.spv"));
 
 	cout << "\n\nImage scaling\n";
 
@@ -10,6 +10,9 @@
 #include <chrono>
 #include "../common/utils.h"
 #include "../common/CImg.h"
+#include "../../common/ProgramBinaryCache.h"
+#include "../../common/KernelSource.h"
+#include "SierpinskiTriangle.embedded.h"
 
 #define VERBOSE true
 
@@ -93,15 +96,9 @@ int Program(int argc, char* argv[])
 		cl::DeviceCommandQueue deviceCommandQueue(context, device, (cl_uint)(16 * 1024 * 1024), (cl::DeviceQueueProperties)CL_QUEUE_ON_DEVICE_DEFAULT, &err);
 		cout << "DeviceCommandQueue return status: " << err << "\n";
 
-		// Read source file
-		ifstream sourceFile("SierpinskiTriangle.cl");
-		string kernelSource(
-			istreambuf_iterator<char>(sourceFile),
-			(istreambuf_iterator<char>()));
-		cl::Program::Sources source{ kernelSource };
-		program = cl::Program(context, source);
-		// Build binary version of program.
-		program.build(device, "-cl-std=CL2.0");
+		string kernelSource = LoadKernelSource("SierpinskiTriangle.cl", embeddedKernelSource);
+		// Build binary version of program from SPIR-V compiled offline or from source, unless previous run cached it.
+		BuildProgramCached(program, context, device, kernelSource, "-cl-std=CL2.0", KernelILPath("SierpinskiTriangle.spv"));
 
 		cout << "\n\nSierpinski Triangle:\n";
 
@@ -12,6 +12,9 @@
 #include <iostream>
 #include <iomanip>
 #include <chrono>
+#include "../../common/ProgramBinaryCache.h"
+#include "../../common/KernelSource.h"
+#include "TaskParallel.embedded.h"
 
 #define RAND_BASE 10
 #define ROW_COUNT 1024
@@ -137,15 +140,10 @@ int Program(int argc, char* argv[])
 	cl::Device device = devices[0];
 	cl::CommandQueue commandQueue(context, device, cl::QueueProperties::OutOfOrder);
 
-	// Read source file
-	ifstream sourceFile("TaskParallel.cl");
-	string kernelSource(
-		istreambuf_iterator<char>(sourceFile),
-		(istreambuf_iterator<char>()));
-	cl::Program::Sources source{ kernelSource };
-	cl::Program program = cl::Program(context, source);
-	// Build binary version of program.
-	program.build(device);
+	string kernelSource = LoadKernelSource("TaskParallel.cl", embeddedKernelSource);
+	// Build binary version of program from SPIR-V compiled offline or from source, unless previous run cached it.
+	cl::Program program;
+	BuildProgramCached(program, context, device, kernelSource, "", KernelILPath("TaskParallel.spv"));
 
 	cout << "\n\nParallelism - Task parallel example\n";
 
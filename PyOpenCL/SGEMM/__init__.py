@@ -1,3 +1,4 @@
+import sys
 import numpy as np
 import pyopencl as cl
 
@@ -26,6 +27,34 @@ def ordered_numpy_array(n, m, start, step):
 def profile(ev):
 	print(f'Time elapsed: {ev.profile.end - ev.profile.start} ns')
 
+def parse_shapes(argv):
+	# Command line: python -m SGEMM [N K M] [N K M] ...
+	if(len(argv) % 3 != 0):
+		raise ValueError('Matrix dimensions must be given as N K M triples!')
+	shapes = [tuple(int(v) for v in argv[i:i + 3]) for i in range(0, len(argv), 3)]
+	return shapes if shapes else [(4800, 1200, 3600)]
+
+# Programs specialized for K_DIM are kept per (device, kernel, shape), so repeated shapes skip build.
+program_cache = {}
+
+def get_program(context, device, kernel_source, kernel_name, kDim):
+	key = (device.int_ptr, kernel_name, kDim)
+	if key in program_cache:
+		return program_cache[key]
+
+	program = cl.Program(context, kernel_source)
+	try:
+		program.build(options=[f'-D K_DIM={kDim}'], devices=[device])
+	except:
+		pbi = cl.program_build_info
+		print(program.get_build_info(device, pbi.LOG))
+		print(program.get_build_info(device, pbi.OPTIONS))
+		print(program.get_build_info(device, pbi.STATUS))
+		raise
+
+	program_cache[key] = program
+	return program
+
 def main():
 	platform = find_opencl_platform('Intel')
 	contextProperties = [(cl.context_properties.PLATFORM, platform)]
@@ -33,9 +62,17 @@ def main():
 	devices = context.get_info(cl.context_info.DEVICES)
 	device = devices[0]
 
-	# This should be the same value as in sgemm.cl kernel code. Be aware of that!
-	kDim = 1200
-	nDim, mDim = 4800, 3600
+	command_queue = cl.CommandQueue(context, device, cl.command_queue_properties.PROFILING_ENABLE)
+
+	# You can also pass multiline string instead of reading file
+	file_handle = open('sgemm.cl', 'r')
+	kernel_source = file_handle.read()
+
+	for nDim, kDim, mDim in parse_shapes(sys.argv[1:]):
+		multiply(context, device, command_queue, kernel_source, nDim, kDim, mDim)
+
+def multiply(context, device, command_queue, kernel_source, nDim, kDim, mDim):
+	print(f'N: {nDim}, K: {kDim}, M: {mDim}')
 
 	A = ordered_numpy_array(nDim, kDim, 0.00001, 0.00001)
 	B = ordered_numpy_array(kDim, mDim, 0.00002, 0.00002)
@@ -52,25 +89,10 @@ def main():
 	buffer_b = cl.Buffer(context, mf.READ_ONLY | mf.COPY_HOST_PTR, hostbuf=B)
 	buffer_c = cl.Buffer(context, mf.WRITE_ONLY, C.nbytes)
 
-	command_queue = cl.CommandQueue(context, device, cl.command_queue_properties.PROFILING_ENABLE)
-
 	cl._enqueue_write_buffer(command_queue, buffer_a, A)
 	# We don't need to copy buffer_b because we used COPY_HOST_PTR flag when creating.
 
-	# You can also pass multiline string instead of reading file
-	file_handle = open('sgemm.cl', 'r')
-	kernel_source = file_handle.read()
-	
-	program = cl.Program(context, kernel_source)
-
-	try:
-		program.build()
-	except:
-		pbi = cl.program_build_info
-		print(program.get_build_info(device, pbi.LOG))
-		print(program.get_build_info(device, pbi.OPTIONS))
-		print(program.get_build_info(device, pbi.STATUS))
-		raise
+	program = get_program(context, device, kernel_source, 'Sgemm', kDim)
 
 	# kernel = cl.Kernel(program, 'Sgemm')
 	# or
@@ -79,8 +101,10 @@ def main():
 	maxComputeUnits = device.get_info(cl.device_info.MAX_COMPUTE_UNITS)
 	print(f'Max compute units: {maxComputeUnits}')
 
-	global_range = (nDim,)
-	local_range = (int(nDim / maxComputeUnits),)
+	# nDim doesn't have to be divisible by local size, global range is rounded up and kernel skips extra rows.
+	local_size = max(1, min(nDim // maxComputeUnits, kernel.get_work_group_info(cl.kernel_work_group_info.WORK_GROUP_SIZE, device)))
+	global_range = ((nDim + local_size - 1) // local_size * local_size,)
+	local_range = (local_size,)
 
 	event = kernel(command_queue, global_range, local_range, np.uint32(nDim), np.uint32(kDim), np.uint32(mDim), buffer_a, buffer_b, buffer_c, np.empty(kDim, dtype=np.float32))
 	command_queue.finish()
@@ -7,8 +7,8 @@ __kernel void Sgemm(const uint nDim, const uint kDim, const uint mDim,
     int k, j;
     float acc;
 
-    // This should be the same size value as kDim
-    float privateA[1200];
+    // K_DIM is passed from host with -D K_DIM=... build option.
+    float privateA[K_DIM];
 
     int localK = get_local_id(0);
     int localM = get_local_size(0);
@@ -20,26 +20,33 @@ __kernel void Sgemm(const uint nDim, const uint kDim, const uint mDim,
         {
             privateA[k] = A[i*kDim + k];
         }
-        
-        for(j = 0; j < mDim; j++)
+    }
+
+    // Work items after the last row (global range rounded up) still copy B and reach every barrier.
+    for(j = 0; j < mDim; j++)
+    {
+        // Copying from global to local memory.
+        for(k = localK; k < kDim; k+=localM)
         {
-            // Copying from global to local memory.
-            for(k = localK; k < kDim; k+=localM)
-            {
-                localB[k] = B[k * mDim + j];
-            }
-        
-            // Wait for all work items in group.
-            barrier(CLK_LOCAL_MEM_FENCE);
+            localB[k] = B[k * mDim + j];
+        }
+
+        // Wait for all work items in group.
+        barrier(CLK_LOCAL_MEM_FENCE);
 
-            acc = 0.0f;        
+        if(i < nDim)
+        {
+            acc = 0.0f;
             for(k = 0; k < kDim; k++)
             {
                 // Now we're getting B values from faster local memory and A values from fastest private memory.
                 acc += privateA[k] * localB[k];
             }
-        
+
             C[i*mDim + j] = acc;
         }
+
+        // Column of B can't be overwritten until every work item is done with it.
+        barrier(CLK_LOCAL_MEM_FENCE);
     }
 }
\ No newline at end of file
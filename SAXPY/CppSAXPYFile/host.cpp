@@ -7,6 +7,9 @@
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include "../../common/ProgramBinaryCache.h"
+#include "../../common/KernelSource.h"
+#include "SAXPY.embedded.h"
 
 using namespace std;
 
@@ -111,15 +114,10 @@ int Program(int argc, char* argv[])
 	commandQueue.enqueueWriteBuffer(deviceInX, true, 0, nBytes, (void*)hostInputX);
 	commandQueue.enqueueWriteBuffer(deviceInY, true, 0, nBytes, (void*)hostInputY);
 
-	// Read source file
-	ifstream sourceFile("SAXPY.cl");
-	string kernelSource(
-		istreambuf_iterator<char>(sourceFile),
-		(istreambuf_iterator<char>()));
-	cl::Program::Sources source{ kernelSource };
-	cl::Program program = cl::Program(context, source);
-	// Build binary version of program.
-	program.build(device);
+	string kernelSource = LoadKernelSource("SAXPY.cl", embeddedKernelSource);
+	// Build binary version of program from SPIR-V compiled offline or from source, unless previous run cached it.
+	cl::Program program;
+	BuildProgramCached(program, context, device, kernelSource, "", KernelILPath("SAXPY.spv"));
 
 	cl::Kernel kernel(program, "Saxpy");
 
@@ -0,0 +1,619 @@
+#include "HostSgemm.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HOST_SGEMM_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC compiles intrinsics of every instruction set without flags, GCC and Clang need them enabled per function.
+#if defined(HOST_SGEMM_X86) && !defined(_MSC_VER)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#define TARGET_F16C __attribute__((target("avx,f16c")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#define TARGET_F16C
+#endif
+
+using namespace std;
+
+// Cache blocking: KC x NR panel of B stays in L1, MC x KC block of A in L2, KC x NC block of B in L3.
+// MC and NC are multiples of every MR and NR used below.
+#define BLOCK_MC 144
+#define BLOCK_KC 256
+#define BLOCK_NC 4096
+#define PACK_ALIGNMENT 64
+
+// SgemmParallel splits C into macro tiles of PARALLEL_TILE_N columns and 1 to PARALLEL_MAX_BLOCKS_PER_TILE
+// blocks of BLOCK_MC rows (one task each). Tiles are narrower than BLOCK_NC to have enough tasks for all cores.
+#define PARALLEL_TILE_N 768
+#define PARALLEL_MAX_BLOCKS_PER_TILE 8
+#define PARALLEL_TASKS_PER_THREAD 4
+
+void* AlignedAlloc(size_t size, size_t alignment)
+{
+#if defined(_MSC_VER)
+	return _aligned_malloc(size, alignment);
+#else
+	void* memory = nullptr;
+	return posix_memalign(&memory, alignment, size) == 0 ? memory : nullptr;
+#endif
+}
+
+void AlignedFree(void* memory)
+{
+#if defined(_MSC_VER)
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+#ifdef HOST_SGEMM_X86
+static void Cpuid(int info[4], int leaf, int subleaf)
+{
+#if defined(_MSC_VER)
+	__cpuidex(info, leaf, subleaf);
+#else
+	__cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+static unsigned long long Xgetbv(unsigned int index)
+{
+#if defined(_MSC_VER)
+	return _xgetbv(index);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+	return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+SimdLevel DetectSimdLevel()
+{
+#ifdef HOST_SGEMM_X86
+	int info[4];
+	Cpuid(info, 0, 0);
+	int maxLeaf = info[0];
+	if (maxLeaf < 7)
+	{
+		return SimdLevel::Scalar;
+	}
+
+	Cpuid(info, 1, 0);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	if (!osxsave || !avx || !fma)
+	{
+		return SimdLevel::Scalar;
+	}
+
+	// Operating system has to save YMM (bits 1, 2) and ZMM (bits 5, 6, 7) registers on context switch.
+	unsigned long long xcr0 = Xgetbv(0);
+	bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+	bool zmmEnabled = (xcr0 & 0xE6) == 0xE6;
+
+	Cpuid(info, 7, 0);
+	bool avx2 = (info[1] & (1 << 5)) != 0;
+	bool avx512f = (info[1] & (1 << 16)) != 0;
+
+	if (avx512f && zmmEnabled)
+	{
+		return SimdLevel::Avx512;
+	}
+	if (avx2 && ymmEnabled)
+	{
+		return SimdLevel::Avx2;
+	}
+#endif
+	return SimdLevel::Scalar;
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::Avx512:
+		return "AVX-512";
+	case SimdLevel::Avx2:
+		return "AVX2";
+	default:
+		return "scalar";
+	}
+}
+
+bool HasF16c()
+{
+#ifdef HOST_SGEMM_X86
+	// F16C converts 8 values in YMM registers, so AVX state has to be enabled by the operating system too.
+	int info[4];
+	Cpuid(info, 1, 0);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool f16c = (info[2] & (1 << 29)) != 0;
+	return osxsave && avx && f16c && (Xgetbv(0) & 0x6) == 0x6;
+#else
+	return false;
+#endif
+}
+
+static uint16_t FloatToHalfScalar(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t mantissa = bits & 0x7FFFFF;
+	int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+
+	if (exponent == 128 + 15)
+	{
+		// Infinity stays infinity, NaN stays quiet NaN.
+		return (uint16_t)(sign | 0x7C00 | (mantissa != 0 ? 0x200 | (mantissa >> 13) : 0));
+	}
+	if (exponent >= 31)
+	{
+		return (uint16_t)(sign | 0x7C00);
+	}
+
+	uint32_t half;
+	uint32_t rest;
+	uint32_t midpoint;
+	if (exponent <= 0)
+	{
+		// Subnormal half, values below half of the smallest one round to zero.
+		if (exponent < -10)
+		{
+			return (uint16_t)sign;
+		}
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		half = mantissa >> shift;
+		rest = mantissa & ((1u << shift) - 1);
+		midpoint = 1u << (shift - 1);
+	}
+	else
+	{
+		half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+		rest = mantissa & 0x1FFF;
+		midpoint = 0x1000;
+	}
+	// Carry from the mantissa increments exponent, which correctly rounds up to the next power of 2 or infinity.
+	if (rest > midpoint || (rest == midpoint && (half & 1) != 0))
+	{
+		half++;
+	}
+	return (uint16_t)(sign | half);
+}
+
+static float HalfToFloatScalar(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+	uint32_t bits;
+
+	if (exponent == 0)
+	{
+		// Zero or subnormal (mantissa * 2^-24), which is a normal float.
+		float value = (float)mantissa * (1.0f / 16777216.0f);
+		return sign != 0 ? -value : value;
+	}
+	if (exponent == 31)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+#ifdef HOST_SGEMM_X86
+TARGET_F16C static void FloatToHalfF16c(const float* source, uint16_t* destination, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128((__m128i*)(destination + i), half);
+	}
+	for (; i < count; i++)
+	{
+		destination[i] = FloatToHalfScalar(source[i]);
+	}
+}
+
+TARGET_F16C static void HalfToFloatF16c(const uint16_t* source, float* destination, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm256_storeu_ps(destination + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(source + i))));
+	}
+	for (; i < count; i++)
+	{
+		destination[i] = HalfToFloatScalar(source[i]);
+	}
+}
+#endif
+
+void FloatToHalf(const float* source, uint16_t* destination, size_t count)
+{
+#ifdef HOST_SGEMM_X86
+	static const bool f16c = HasF16c();
+	if (f16c)
+	{
+		FloatToHalfF16c(source, destination, count);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; i++)
+	{
+		destination[i] = FloatToHalfScalar(source[i]);
+	}
+}
+
+void HalfToFloat(const uint16_t* source, float* destination, size_t count)
+{
+#ifdef HOST_SGEMM_X86
+	static const bool f16c = HasF16c();
+	if (f16c)
+	{
+		HalfToFloatF16c(source, destination, count);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; i++)
+	{
+		destination[i] = HalfToFloatScalar(source[i]);
+	}
+}
+
+// Micro kernel adds product of packed MR x kc panel of A and packed kc x NR panel of B to the mr x nr block of C.
+// mr and nr are smaller than MR and NR only on the edges of C.
+typedef void (*MicroKernelFunction)(int kc, const float* a, const float* b, float* c, int ldc, int mr, int nr);
+
+struct MicroKernel
+{
+	int mr;
+	int nr;
+	MicroKernelFunction function;
+};
+
+static void AddTile(const float* tile, int tileStride, float* c, int ldc, int mr, int nr)
+{
+	for (int r = 0; r < mr; r++)
+	{
+		for (int j = 0; j < nr; j++)
+		{
+			c[r * ldc + j] += tile[r * tileStride + j];
+		}
+	}
+}
+
+#define SCALAR_MR 4
+#define SCALAR_NR 8
+
+static void MicroKernelScalar(int kc, const float* a, const float* b, float* c, int ldc, int mr, int nr)
+{
+	float acc[SCALAR_MR][SCALAR_NR] = {};
+
+	for (int k = 0; k < kc; k++)
+	{
+		for (int r = 0; r < SCALAR_MR; r++)
+		{
+			for (int j = 0; j < SCALAR_NR; j++)
+			{
+				acc[r][j] += a[r] * b[j];
+			}
+		}
+		a += SCALAR_MR;
+		b += SCALAR_NR;
+	}
+
+	AddTile(&acc[0][0], SCALAR_NR, c, ldc, mr, nr);
+}
+
+#ifdef HOST_SGEMM_X86
+// 6 x 16 block of C is kept in 12 YMM registers, 2 registers hold row of B and 1 broadcasted value of A.
+TARGET_AVX2 static void MicroKernelAvx2(int kc, const float* a, const float* b, float* c, int ldc, int mr, int nr)
+{
+	__m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+	__m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+	__m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+	__m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+	__m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+	__m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+	__m256 a0;
+
+	for (int k = 0; k < kc; k++)
+	{
+		__m256 b0 = _mm256_load_ps(b);
+		__m256 b1 = _mm256_load_ps(b + 8);
+
+		a0 = _mm256_broadcast_ss(a + 0);
+		c00 = _mm256_fmadd_ps(a0, b0, c00);
+		c01 = _mm256_fmadd_ps(a0, b1, c01);
+		a0 = _mm256_broadcast_ss(a + 1);
+		c10 = _mm256_fmadd_ps(a0, b0, c10);
+		c11 = _mm256_fmadd_ps(a0, b1, c11);
+		a0 = _mm256_broadcast_ss(a + 2);
+		c20 = _mm256_fmadd_ps(a0, b0, c20);
+		c21 = _mm256_fmadd_ps(a0, b1, c21);
+		a0 = _mm256_broadcast_ss(a + 3);
+		c30 = _mm256_fmadd_ps(a0, b0, c30);
+		c31 = _mm256_fmadd_ps(a0, b1, c31);
+		a0 = _mm256_broadcast_ss(a + 4);
+		c40 = _mm256_fmadd_ps(a0, b0, c40);
+		c41 = _mm256_fmadd_ps(a0, b1, c41);
+		a0 = _mm256_broadcast_ss(a + 5);
+		c50 = _mm256_fmadd_ps(a0, b0, c50);
+		c51 = _mm256_fmadd_ps(a0, b1, c51);
+
+		a += 6;
+		b += 16;
+	}
+
+	__m256 acc[6][2] = { { c00, c01 }, { c10, c11 }, { c20, c21 }, { c30, c31 }, { c40, c41 }, { c50, c51 } };
+	if (mr == 6 && nr == 16)
+	{
+		for (int r = 0; r < 6; r++)
+		{
+			float* row = c + r * ldc;
+			_mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), acc[r][0]));
+			_mm256_storeu_ps(row + 8, _mm256_add_ps(_mm256_loadu_ps(row + 8), acc[r][1]));
+		}
+		return;
+	}
+
+	alignas(32) float tile[6 * 16];
+	for (int r = 0; r < 6; r++)
+	{
+		_mm256_store_ps(tile + r * 16, acc[r][0]);
+		_mm256_store_ps(tile + r * 16 + 8, acc[r][1]);
+	}
+	AddTile(tile, 16, c, ldc, mr, nr);
+}
+
+// 6 x 32 block of C is kept in 12 ZMM registers.
+TARGET_AVX512 static void MicroKernelAvx512(int kc, const float* a, const float* b, float* c, int ldc, int mr, int nr)
+{
+	__m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+	__m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+	__m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+	__m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+	__m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+	__m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+	__m512 a0;
+
+	for (int k = 0; k < kc; k++)
+	{
+		__m512 b0 = _mm512_load_ps(b);
+		__m512 b1 = _mm512_load_ps(b + 16);
+
+		a0 = _mm512_set1_ps(a[0]);
+		c00 = _mm512_fmadd_ps(a0, b0, c00);
+		c01 = _mm512_fmadd_ps(a0, b1, c01);
+		a0 = _mm512_set1_ps(a[1]);
+		c10 = _mm512_fmadd_ps(a0, b0, c10);
+		c11 = _mm512_fmadd_ps(a0, b1, c11);
+		a0 = _mm512_set1_ps(a[2]);
+		c20 = _mm512_fmadd_ps(a0, b0, c20);
+		c21 = _mm512_fmadd_ps(a0, b1, c21);
+		a0 = _mm512_set1_ps(a[3]);
+		c30 = _mm512_fmadd_ps(a0, b0, c30);
+		c31 = _mm512_fmadd_ps(a0, b1, c31);
+		a0 = _mm512_set1_ps(a[4]);
+		c40 = _mm512_fmadd_ps(a0, b0, c40);
+		c41 = _mm512_fmadd_ps(a0, b1, c41);
+		a0 = _mm512_set1_ps(a[5]);
+		c50 = _mm512_fmadd_ps(a0, b0, c50);
+		c51 = _mm512_fmadd_ps(a0, b1, c51);
+
+		a += 6;
+		b += 32;
+	}
+
+	__m512 acc[6][2] = { { c00, c01 }, { c10, c11 }, { c20, c21 }, { c30, c31 }, { c40, c41 }, { c50, c51 } };
+	if (mr == 6 && nr == 32)
+	{
+		for (int r = 0; r < 6; r++)
+		{
+			float* row = c + r * ldc;
+			_mm512_storeu_ps(row, _mm512_add_ps(_mm512_loadu_ps(row), acc[r][0]));
+			_mm512_storeu_ps(row + 16, _mm512_add_ps(_mm512_loadu_ps(row + 16), acc[r][1]));
+		}
+		return;
+	}
+
+	alignas(64) float tile[6 * 32];
+	for (int r = 0; r < 6; r++)
+	{
+		_mm512_store_ps(tile + r * 32, acc[r][0]);
+		_mm512_store_ps(tile + r * 32 + 16, acc[r][1]);
+	}
+	AddTile(tile, 32, c, ldc, mr, nr);
+}
+#endif
+
+static MicroKernel SelectMicroKernel(SimdLevel level)
+{
+#ifdef HOST_SGEMM_X86
+	if (level == SimdLevel::Avx512)
+	{
+		return { 6, 32, MicroKernelAvx512 };
+	}
+	if (level == SimdLevel::Avx2)
+	{
+		return { 6, 16, MicroKernelAvx2 };
+	}
+#endif
+	return { SCALAR_MR, SCALAR_NR, MicroKernelScalar };
+}
+
+// Copies mc x kc block of A into panels of MR rows, every panel is stored column by column (MR values per k).
+// Rows after the end of A are filled with zeros, so micro kernel always reads full panels.
+static void PackA(int mc, int kc, const float* A, int lda, int mr, float* packed)
+{
+	for (int i = 0; i < mc; i += mr)
+	{
+		int rows = min(mr, mc - i);
+		for (int k = 0; k < kc; k++)
+		{
+			for (int r = 0; r < rows; r++)
+			{
+				packed[r] = A[(i + r) * lda + k];
+			}
+			for (int r = rows; r < mr; r++)
+			{
+				packed[r] = 0.0f;
+			}
+			packed += mr;
+		}
+	}
+}
+
+// Copies kc x nc block of B into panels of NR columns, every panel is stored row by row (NR values per k).
+static void PackB(int kc, int nc, const float* B, int ldb, int nr, float* packed)
+{
+	for (int j = 0; j < nc; j += nr)
+	{
+		int cols = min(nr, nc - j);
+		for (int k = 0; k < kc; k++)
+		{
+			const float* row = B + k * ldb + j;
+			for (int c = 0; c < cols; c++)
+			{
+				packed[c] = row[c];
+			}
+			for (int c = cols; c < nr; c++)
+			{
+				packed[c] = 0.0f;
+			}
+			packed += nr;
+		}
+	}
+}
+
+// Multiplies packed mc x kc block of A by packed kc x nc block of B and adds result to C.
+static void MultiplyPacked(const MicroKernel& kernel, int mc, int nc, int kc,
+	const float* packedA, const float* packedB, float* C, int ldc)
+{
+	for (int j = 0; j < nc; j += kernel.nr)
+	{
+		for (int i = 0; i < mc; i += kernel.mr)
+		{
+			kernel.function(kc, packedA + i * kc, packedB + j * kc, C + i * ldc + j, ldc,
+				min(kernel.mr, mc - i), min(kernel.nr, nc - j));
+		}
+	}
+}
+
+void SgemmBlocked(const int nDim, const int mDim, const int kDim, const float* A, const float* B, float* C)
+{
+	static const MicroKernel kernel = SelectMicroKernel(DetectSimdLevel());
+
+	float* packedA = (float*)AlignedAlloc(sizeof(float) * BLOCK_MC * BLOCK_KC, PACK_ALIGNMENT);
+	float* packedB = (float*)AlignedAlloc(sizeof(float) * BLOCK_KC * BLOCK_NC, PACK_ALIGNMENT);
+
+	for (int i = 0; i < nDim; i++)
+	{
+		memset(C + (size_t)i * mDim, 0, sizeof(float) * mDim);
+	}
+
+	for (int jc = 0; jc < mDim; jc += BLOCK_NC)
+	{
+		int nc = min(BLOCK_NC, mDim - jc);
+		for (int pc = 0; pc < kDim; pc += BLOCK_KC)
+		{
+			int kc = min(BLOCK_KC, kDim - pc);
+			PackB(kc, nc, B + (size_t)pc * mDim + jc, mDim, kernel.nr, packedB);
+
+			for (int ic = 0; ic < nDim; ic += BLOCK_MC)
+			{
+				int mc = min(BLOCK_MC, nDim - ic);
+				PackA(mc, kc, A + (size_t)ic * kDim + pc, kDim, kernel.mr, packedA);
+				MultiplyPacked(kernel, mc, nc, kc, packedA, packedB, C + (size_t)ic * mDim + jc, mDim);
+			}
+		}
+	}
+
+	AlignedFree(packedA);
+	AlignedFree(packedB);
+}
+
+void SgemmParallel(const int nDim, const int mDim, const int kDim, const float* A, const float* B, float* C)
+{
+	static const MicroKernel kernel = SelectMicroKernel(DetectSimdLevel());
+	ThreadPool& pool = ThreadPool::Instance();
+
+	// Packing buffers belong to workers and are reused by every task the worker runs.
+	vector<float*> packedA(pool.Size());
+	vector<float*> packedB(pool.Size());
+	for (unsigned w = 0; w < pool.Size(); w++)
+	{
+		packedA[w] = (float*)AlignedAlloc(sizeof(float) * BLOCK_MC * BLOCK_KC, PACK_ALIGNMENT);
+		packedB[w] = (float*)AlignedAlloc(sizeof(float) * BLOCK_KC * PARALLEL_TILE_N, PACK_ALIGNMENT);
+	}
+
+	// Packed B is reused by every BLOCK_MC block of the macro tile, so tiles are as high as possible
+	// while there are still at least PARALLEL_TASKS_PER_THREAD tasks per worker for load balancing.
+	int blocksN = (nDim + BLOCK_MC - 1) / BLOCK_MC;
+	int tilesM = (mDim + PARALLEL_TILE_N - 1) / PARALLEL_TILE_N;
+	int blocksPerTile = (blocksN * tilesM) / (PARALLEL_TASKS_PER_THREAD * (int)pool.Size());
+	blocksPerTile = max(1, min(PARALLEL_MAX_BLOCKS_PER_TILE, blocksPerTile));
+	int tileRows = blocksPerTile * BLOCK_MC;
+	int tilesN = (nDim + tileRows - 1) / tileRows;
+
+	// Every task owns one macro tile of C and walks through the whole K dimension,
+	// so tiles are independent and don't need synchronization.
+	pool.ParallelFor((size_t)tilesN * tilesM, [&](size_t index, unsigned worker)
+	{
+		int it = (int)(index / tilesM) * tileRows;
+		int jc = (int)(index % tilesM) * PARALLEL_TILE_N;
+		int rows = min(tileRows, nDim - it);
+		int nc = min(PARALLEL_TILE_N, mDim - jc);
+
+		for (int i = 0; i < rows; i++)
+		{
+			memset(C + (size_t)(it + i) * mDim + jc, 0, sizeof(float) * nc);
+		}
+
+		for (int pc = 0; pc < kDim; pc += BLOCK_KC)
+		{
+			int kc = min(BLOCK_KC, kDim - pc);
+			PackB(kc, nc, B + (size_t)pc * mDim + jc, mDim, kernel.nr, packedB[worker]);
+
+			for (int ic = it; ic < it + rows; ic += BLOCK_MC)
+			{
+				int mc = min(BLOCK_MC, it + rows - ic);
+				PackA(mc, kc, A + (size_t)ic * kDim + pc, kDim, kernel.mr, packedA[worker]);
+				MultiplyPacked(kernel, mc, nc, kc, packedA[worker], packedB[worker], C + (size_t)ic * mDim + jc, mDim);
+			}
+		}
+	});
+
+	for (unsigned w = 0; w < pool.Size(); w++)
+	{
+		AlignedFree(packedA[w]);
+		AlignedFree(packedB[w]);
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Host (CPU) implementations of SGEMM used for validation of kernels results
+// and as a fallback when there is no OpenCL device.
+// All matrices are row-major: C (n x m) = A (n x k) * B (k x m).
+
+#include <cstddef>
+#include <cstdint>
+
+// Memory aligned to the given power of 2 (cache line, page), freed with AlignedFree.
+void* AlignedAlloc(size_t size, size_t alignment);
+void AlignedFree(void* memory);
+
+enum class SimdLevel
+{
+	Scalar,
+	Avx2,
+	Avx512
+};
+
+// Checks with CPUID (and XGETBV for OS support of wide registers) which micro kernel can be used.
+SimdLevel DetectSimdLevel();
+const char* SimdLevelName(SimdLevel level);
+
+// Packed and cache blocked SGEMM. A and B are copied block by block into contiguous panels
+// which fit into caches, C is computed by register blocked micro kernel selected with DetectSimdLevel.
+void SgemmBlocked(const int nDim, const int mDim, const int kDim, const float* A, const float* B, float* C);
+
+// Multithreaded SgemmBlocked. C is split into macro tiles which are computed on work-stealing thread pool
+// sized to the hardware concurrency, every worker has its own packing buffers.
+void SgemmParallel(const int nDim, const int mDim, const int kDim, const float* A, const float* B, float* C);
+
+// Conversions between float and IEEE 754 half (binary16) stored as uint16_t, rounding to nearest even.
+// They use F16C instructions when HasF16c, otherwise bit manipulation.
+bool HasF16c();
+void FloatToHalf(const float* source, uint16_t* destination, size_t count);
+void HalfToFloat(const uint16_t* source, float* destination, size_t count);
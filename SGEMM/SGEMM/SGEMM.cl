@@ -75,6 +75,8 @@ __kernel void Sgemm_private(const uint nDim, const uint kDim, const uint mDim,
 }
 
 // Copy columns of B into local (faster) work group memory.
+// Global range can be rounded up to the multiple of work group size. Work items after the last row of C
+// still help with copying B and reach every barrier, they only skip computing.
 __kernel void Sgemm_local(const uint nDim, const uint kDim, const uint mDim,
     const __global float* A,  const __global float* B, __global float* C,
     __local float* localB)
@@ -95,26 +97,1071 @@ __kernel void Sgemm_local(const uint nDim, const uint kDim, const uint mDim,
         {
             privateA[k] = A[i*kDim + k];
         }
-        
-        for(j = 0; j < mDim; j++)
+    }
+
+    for(j = 0; j < mDim; j++)
+    {
+        // Copying from global to local memory.
+        for(k = localK; k < kDim; k+=localM)
+        {
+            localB[k] = B[k * mDim + j];
+        }
+
+        // Wait for all work items in group.
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if(i < nDim)
         {
-            // Copying from global to local memory.
-            for(k = localK; k < kDim; k+=localM)
+            acc = 0.0f;
+            for(k = 0; k < kDim; k++)
             {
-                localB[k] = B[k * mDim + j];
+                // Now we're getting B values from faster local memory and A values from fastest private memory.
+                acc += privateA[k] * localB[k];
             }
-        
-            // Wait for all work items in group.
-            barrier(CLK_LOCAL_MEM_FENCE);
 
-            acc = 0.0f;        
+            C[i*mDim + j] = acc;
+        }
+
+        // Column of B can't be overwritten until every work item is done with it.
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+// Sgemm_local with B already transposed (BT is m x k): column j of B is the row j of BT,
+// so work items copy neighbouring addresses instead of reading with stride mDim.
+__kernel void Sgemm_local_transposed(const uint nDim, const uint kDim, const uint mDim,
+    const __global float* A,  const __global float* BT, __global float* C,
+    __local float* localB)
+{
+    int i = get_global_id(0);
+    int k, j;
+    float acc;
+
+    float privateA[K_DIM];
+
+    int localK = get_local_id(0);
+    int localM = get_local_size(0);
+
+    if(i < nDim)
+    {
+        for(k = 0; k < kDim; k++)
+        {
+            privateA[k] = A[i*kDim + k];
+        }
+    }
+
+    for(j = 0; j < mDim; j++)
+    {
+        for(k = localK; k < kDim; k+=localM)
+        {
+            localB[k] = BT[j * kDim + k];
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if(i < nDim)
+        {
+            acc = 0.0f;
             for(k = 0; k < kDim; k++)
             {
-                // Now we're getting B values from faster local memory and A values from fastest private memory.
                 acc += privateA[k] * localB[k];
             }
-        
+
             C[i*mDim + j] = acc;
         }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+// Sgemm_local with A, B and C stored as half and accumulated in float. vload_half and vstore_half
+// convert values on load and store, so the kernel doesn't need cl_khr_fp16.
+__kernel void Sgemm_local_half(const uint nDim, const uint kDim, const uint mDim,
+    const __global half* A,  const __global half* B, __global half* C,
+    __local float* localB)
+{
+    int i = get_global_id(0);
+    int k, j;
+    float acc;
+
+    float privateA[K_DIM];
+
+    int localK = get_local_id(0);
+    int localM = get_local_size(0);
+
+    if(i < nDim)
+    {
+        for(k = 0; k < kDim; k++)
+        {
+            privateA[k] = vload_half(i*kDim + k, A);
+        }
+    }
+
+    for(j = 0; j < mDim; j++)
+    {
+        for(k = localK; k < kDim; k+=localM)
+        {
+            localB[k] = vload_half(k * mDim + j, B);
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if(i < nDim)
+        {
+            acc = 0.0f;
+            for(k = 0; k < kDim; k++)
+            {
+                acc += privateA[k] * localB[k];
+            }
+
+            vstore_half_rte(acc, i*mDim + j, C);
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+// Repack of M (rows x cols) into MT (cols x rows). Square tile is read by rows and written by columns
+// of local memory, so both global reads and writes are coalesced. Extra column of the tile
+// moves values of one column into different local memory banks.
+// Global range is rounded up to TRANSPOSE_TILE_SIZE, work group is TRANSPOSE_TILE_SIZE x TRANSPOSE_TILE_SIZE.
+__kernel void Transpose(const uint rows, const uint cols, const __global float* M, __global float* MT)
+{
+    const int localCol = get_local_id(0);
+    const int localRow = get_local_id(1);
+    const int tileCol = get_group_id(0) * TRANSPOSE_TILE_SIZE;
+    const int tileRow = get_group_id(1) * TRANSPOSE_TILE_SIZE;
+
+    __local float tile[TRANSPOSE_TILE_SIZE][TRANSPOSE_TILE_SIZE + 1];
+
+    int row = tileRow + localRow;
+    int col = tileCol + localCol;
+    if(row < rows && col < cols)
+    {
+        tile[localRow][localCol] = M[(size_t)row * cols + col];
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Row of MT is the column of the tile.
+    row = tileCol + localRow;
+    col = tileRow + localCol;
+    if(row < cols && col < rows)
+    {
+        MT[(size_t)row * rows + col] = tile[localCol][localRow];
+    }
+}
+
+// Square tiles of A and B are staged in local memory and every work item
+// computes WORK_PER_THREAD x WORK_PER_THREAD block of C in private registers.
+// Dimension 0 of NDRange walks through columns of C so neighbouring work items
+// read neighbouring addresses of A, B and C (coalesced access).
+// Parts of tiles outside of matrices are filled with zeros, so any nDim, kDim, mDim are allowed
+// as long as global range is rounded up to the TILE_SIZE.
+#define REDUCED_TILE_SIZE (TILE_SIZE / WORK_PER_THREAD)
+
+#define CONCAT(a, b) a##b
+#define VLOAD(width) CONCAT(vload, width)
+#define VSTORE(width) CONCAT(vstore, width)
+
+// Copies VECTOR_WIDTH consecutive values from row of global matrix (rows x cols, ld floats between rows)
+// into local memory. Values outside of matrix are replaced with zeros.
+inline void CopyToLocal(const __global float* M, const uint rows, const uint cols, const uint ld, const int row, const int col,
+    __local float* destination)
+{
+    int e;
+#if VECTOR_WIDTH > 1
+    if(row < rows && col + VECTOR_WIDTH <= cols)
+    {
+        VSTORE(VECTOR_WIDTH)(VLOAD(VECTOR_WIDTH)(0, M + row*ld + col), 0, destination);
+        return;
+    }
+#endif
+    for(e = 0; e < VECTOR_WIDTH; e++)
+    {
+        destination[e] = (row < rows && col + e < cols) ? M[row*ld + col + e] : 0.0f;
+    }
+}
+
+__kernel void Sgemm_tiled(const uint nDim, const uint kDim, const uint mDim,
+    const __global float* A,  const __global float* B, __global float* C)
+{
+    const int localCol = get_local_id(0);
+    const int localRow = get_local_id(1);
+    const int localId = localRow * REDUCED_TILE_SIZE + localCol;
+    const int groupCol = get_group_id(0) * TILE_SIZE;
+    const int groupRow = get_group_id(1) * TILE_SIZE;
+    int t, k, r, c, v;
+
+    __local float tileA[TILE_SIZE][TILE_SIZE];
+    __local float tileB[TILE_SIZE][TILE_SIZE];
+
+    float acc[WORK_PER_THREAD][WORK_PER_THREAD];
+    float privateB[WORK_PER_THREAD];
+
+    for(r = 0; r < WORK_PER_THREAD; r++)
+    {
+        for(c = 0; c < WORK_PER_THREAD; c++)
+        {
+            acc[r][c] = 0.0f;
+        }
+    }
+
+    for(t = 0; t < kDim; t += TILE_SIZE)
+    {
+        // Copying tiles from global to local memory. Tile is split into vectors of VECTOR_WIDTH values,
+        // consecutive work items copy consecutive vectors of the same row.
+        for(v = localId; v < TILE_SIZE * TILE_SIZE / VECTOR_WIDTH; v += REDUCED_TILE_SIZE * REDUCED_TILE_SIZE)
+        {
+            int row = v / (TILE_SIZE / VECTOR_WIDTH);
+            int col = (v % (TILE_SIZE / VECTOR_WIDTH)) * VECTOR_WIDTH;
+            CopyToLocal(A, nDim, kDim, kDim, groupRow + row, t + col, &tileA[row][col]);
+            CopyToLocal(B, kDim, mDim, mDim, t + row, groupCol + col, &tileB[row][col]);
+        }
+
+        // Wait for all work items in group.
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        #pragma unroll UNROLL
+        for(k = 0; k < TILE_SIZE; k++)
+        {
+            // Values of B are reused by every row of the block so keep them in registers.
+            for(c = 0; c < WORK_PER_THREAD; c++)
+            {
+                privateB[c] = tileB[k][localCol + c * REDUCED_TILE_SIZE];
+            }
+
+            for(r = 0; r < WORK_PER_THREAD; r++)
+            {
+                float valueA = tileA[localRow + r * REDUCED_TILE_SIZE][k];
+                for(c = 0; c < WORK_PER_THREAD; c++)
+                {
+                    acc[r][c] += valueA * privateB[c];
+                }
+            }
+        }
+
+        // Tiles can't be overwritten until every work item is done with them.
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for(r = 0; r < WORK_PER_THREAD; r++)
+    {
+        int i = groupRow + localRow + r * REDUCED_TILE_SIZE;
+        for(c = 0; c < WORK_PER_THREAD; c++)
+        {
+            int j = groupCol + localCol + c * REDUCED_TILE_SIZE;
+            if(i < nDim && j < mDim)
+            {
+                C[i*mDim + j] = acc[r][c];
+            }
+        }
+    }
+}
+
+#define VLOAD_HALF(width) CONCAT(vload_half, width)
+
+// CopyToLocal for matrices stored as half, values are converted to float in local memory.
+inline void CopyHalfToLocal(const __global half* M, const uint rows, const uint cols, const uint ld, const int row, const int col,
+    __local float* destination)
+{
+    int e;
+#if VECTOR_WIDTH > 1
+    if(row < rows && col + VECTOR_WIDTH <= cols)
+    {
+        VSTORE(VECTOR_WIDTH)(VLOAD_HALF(VECTOR_WIDTH)(0, M + row*ld + col), 0, destination);
+        return;
+    }
+#endif
+    for(e = 0; e < VECTOR_WIDTH; e++)
+    {
+        destination[e] = (row < rows && col + e < cols) ? vload_half(row*ld + col + e, M) : 0.0f;
+    }
+}
+
+// Sgemm_tiled with A, B and C stored as half: global memory traffic is halved,
+// tiles in local memory and the accumulation stay in float.
+__kernel void Sgemm_tiled_half(const uint nDim, const uint kDim, const uint mDim,
+    const __global half* A,  const __global half* B, __global half* C)
+{
+    const int localCol = get_local_id(0);
+    const int localRow = get_local_id(1);
+    const int localId = localRow * REDUCED_TILE_SIZE + localCol;
+    const int groupCol = get_group_id(0) * TILE_SIZE;
+    const int groupRow = get_group_id(1) * TILE_SIZE;
+    int t, k, r, c, v;
+
+    __local float tileA[TILE_SIZE][TILE_SIZE];
+    __local float tileB[TILE_SIZE][TILE_SIZE];
+
+    float acc[WORK_PER_THREAD][WORK_PER_THREAD];
+    float privateB[WORK_PER_THREAD];
+
+    for(r = 0; r < WORK_PER_THREAD; r++)
+    {
+        for(c = 0; c < WORK_PER_THREAD; c++)
+        {
+            acc[r][c] = 0.0f;
+        }
+    }
+
+    for(t = 0; t < kDim; t += TILE_SIZE)
+    {
+        for(v = localId; v < TILE_SIZE * TILE_SIZE / VECTOR_WIDTH; v += REDUCED_TILE_SIZE * REDUCED_TILE_SIZE)
+        {
+            int row = v / (TILE_SIZE / VECTOR_WIDTH);
+            int col = (v % (TILE_SIZE / VECTOR_WIDTH)) * VECTOR_WIDTH;
+            CopyHalfToLocal(A, nDim, kDim, kDim, groupRow + row, t + col, &tileA[row][col]);
+            CopyHalfToLocal(B, kDim, mDim, mDim, t + row, groupCol + col, &tileB[row][col]);
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        #pragma unroll UNROLL
+        for(k = 0; k < TILE_SIZE; k++)
+        {
+            for(c = 0; c < WORK_PER_THREAD; c++)
+            {
+                privateB[c] = tileB[k][localCol + c * REDUCED_TILE_SIZE];
+            }
+
+            for(r = 0; r < WORK_PER_THREAD; r++)
+            {
+                float valueA = tileA[localRow + r * REDUCED_TILE_SIZE][k];
+                for(c = 0; c < WORK_PER_THREAD; c++)
+                {
+                    acc[r][c] += valueA * privateB[c];
+                }
+            }
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for(r = 0; r < WORK_PER_THREAD; r++)
+    {
+        int i = groupRow + localRow + r * REDUCED_TILE_SIZE;
+        for(c = 0; c < WORK_PER_THREAD; c++)
+        {
+            int j = groupCol + localCol + c * REDUCED_TILE_SIZE;
+            if(i < nDim && j < mDim)
+            {
+                vstore_half_rte(acc[r][c], i*mDim + j, C);
+            }
+        }
+    }
+}
+
+// Tall-skinny SGEMM, C (n x SKINNY_DIM) has at most SKINNY_MAX_DIM columns, SKINNY_DIM 1 is SGEMV y = A * x.
+// One work group reduces one row of A over K like Freivalds_matvec: SKINNY_LOCAL_SIZE work items
+// sum interleaved parts of the row into SKINNY_DIM partial sums, which are added in local memory.
+__kernel void Sgemm_tall(const uint nDim, const uint kDim, const uint mDim,
+    const __global float* A, const __global float* B, __global float* C)
+{
+    const int row = get_group_id(0);
+    const int localId = get_local_id(0);
+    const __global float* rowA = A + (size_t)row * kDim;
+    int k, c, s;
+    float acc[SKINNY_DIM];
+
+    __local float partial[SKINNY_DIM][SKINNY_LOCAL_SIZE];
+
+    for(c = 0; c < SKINNY_DIM; c++)
+    {
+        acc[c] = 0.0f;
+    }
+
+    for(k = localId; k < kDim; k += SKINNY_LOCAL_SIZE)
+    {
+        float valueA = rowA[k];
+        for(c = 0; c < SKINNY_DIM; c++)
+        {
+            acc[c] += valueA * B[k*SKINNY_DIM + c];
+        }
+    }
+    for(c = 0; c < SKINNY_DIM; c++)
+    {
+        partial[c][localId] = acc[c];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(s = SKINNY_LOCAL_SIZE / 2; s > 0; s /= 2)
+    {
+        if(localId < s)
+        {
+            for(c = 0; c < SKINNY_DIM; c++)
+            {
+                partial[c][localId] += partial[c][localId + s];
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if(localId < SKINNY_DIM)
+    {
+        C[row*SKINNY_DIM + localId] = partial[localId][0];
+    }
+}
+
+// Short-wide SGEMM, C (SKINNY_DIM x m) has at most SKINNY_MAX_DIM rows. Work group is WIDE_COLUMNS x WIDE_SPLIT_K,
+// dimension 0 are neighbouring columns of B and C and dimension 1 splits K into interleaved slices,
+// so there are enough work items even for few columns. Sums of the slices are added in local memory.
+__kernel void Sgemm_wide(const uint nDim, const uint kDim, const uint mDim,
+    const __global float* A, const __global float* B, __global float* C)
+{
+    const int j = get_global_id(0);
+    const int localCol = get_local_id(0);
+    const int slice = get_local_id(1);
+    int k, r, s;
+    float acc[SKINNY_DIM];
+
+    __local float partial[SKINNY_DIM][WIDE_SPLIT_K][WIDE_COLUMNS];
+
+    for(r = 0; r < SKINNY_DIM; r++)
+    {
+        acc[r] = 0.0f;
+    }
+
+    if(j < mDim)
+    {
+        for(k = slice; k < kDim; k += WIDE_SPLIT_K)
+        {
+            float valueB = B[k*mDim + j];
+            for(r = 0; r < SKINNY_DIM; r++)
+            {
+                acc[r] += A[r*kDim + k] * valueB;
+            }
+        }
+    }
+    for(r = 0; r < SKINNY_DIM; r++)
+    {
+        partial[r][slice][localCol] = acc[r];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(s = WIDE_SPLIT_K / 2; s > 0; s /= 2)
+    {
+        if(slice < s)
+        {
+            for(r = 0; r < SKINNY_DIM; r++)
+            {
+                partial[r][slice][localCol] += partial[r][slice + s][localCol];
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if(j < mDim)
+    {
+        for(r = slice; r < SKINNY_DIM; r += WIDE_SPLIT_K)
+        {
+            C[r*mDim + j] = partial[r][0][localCol];
+        }
     }
-}
\ No newline at end of file
+}
+
+// Batched multiplication of many matrices with the same shape in one launch.
+// Dimension 2 of NDRange is the index of the batch entry, dimensions 0 and 1 are column and row of C
+// as in Sgemm_tiled. Every work group computes BATCH_TILE_SIZE x BATCH_TILE_SIZE block of C of one entry,
+// one value per work item.
+inline void SgemmBatchEntry(const uint nDim, const uint kDim, const uint mDim,
+    const __global float* A, const __global float* B, __global float* C,
+    __local float* tileA, __local float* tileB)
+{
+    const int localCol = get_local_id(0);
+    const int localRow = get_local_id(1);
+    const int i = get_group_id(1) * BATCH_TILE_SIZE + localRow;
+    const int j = get_group_id(0) * BATCH_TILE_SIZE + localCol;
+    int t, k;
+    float acc = 0.0f;
+
+    for(t = 0; t < kDim; t += BATCH_TILE_SIZE)
+    {
+        tileA[localRow*BATCH_TILE_SIZE + localCol] = (i < nDim && t + localCol < kDim) ? A[i*kDim + t + localCol] : 0.0f;
+        tileB[localRow*BATCH_TILE_SIZE + localCol] = (t + localRow < kDim && j < mDim) ? B[(t + localRow)*mDim + j] : 0.0f;
+
+        // Wait for all work items in group.
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for(k = 0; k < BATCH_TILE_SIZE; k++)
+        {
+            acc += tileA[localRow*BATCH_TILE_SIZE + k] * tileB[k*BATCH_TILE_SIZE + localCol];
+        }
+
+        // Tiles can't be overwritten until every work item is done with them.
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if(i < nDim && j < mDim)
+    {
+        C[i*mDim + j] = acc;
+    }
+}
+
+// Entries are stored one after another with constant strides (in floats).
+// Stride 0 shares one matrix with the whole batch (i.e. the same B for every A).
+__kernel void Sgemm_batched(const uint nDim, const uint kDim, const uint mDim,
+    const __global float* A, const uint strideA,
+    const __global float* B, const uint strideB,
+    __global float* C, const uint strideC)
+{
+    __local float tileA[BATCH_TILE_SIZE * BATCH_TILE_SIZE];
+    __local float tileB[BATCH_TILE_SIZE * BATCH_TILE_SIZE];
+    const size_t batch = get_global_id(2);
+
+    SgemmBatchEntry(nDim, kDim, mDim, A + batch*strideA, B + batch*strideB, C + batch*strideC, tileA, tileB);
+}
+
+// Entries are anywhere in the buffers, offsets (in floats) of every entry replace the array of pointers.
+__kernel void Sgemm_batched_offsets(const uint nDim, const uint kDim, const uint mDim,
+    const __global float* A, const __global uint* offsetsA,
+    const __global float* B, const __global uint* offsetsB,
+    __global float* C, const __global uint* offsetsC)
+{
+    __local float tileA[BATCH_TILE_SIZE * BATCH_TILE_SIZE];
+    __local float tileB[BATCH_TILE_SIZE * BATCH_TILE_SIZE];
+    const size_t batch = get_global_id(2);
+
+    SgemmBatchEntry(nDim, kDim, mDim, A + offsetsA[batch], B + offsetsB[batch], C + offsetsC[batch], tileA, tileB);
+}
+
+// BLAS SGEMM: C = alpha * op(A) * op(B) + beta * C, op(A) is n x k, op(B) is k x m.
+// TRANS_A / TRANS_B (build options) select op(X) = X^T, then A is stored as k x n and B as m x k.
+// lda, ldb, ldc are distances between rows and offsets are positions of the first value (both in floats),
+// so blocks of bigger matrices can be multiplied in place. Tiling is the same as in Sgemm_tiled,
+// tiles are copied in storage order and transposed only when read from local memory.
+#if TRANS_A
+#define TILE_A(i, k) tileA[k][i]
+#else
+#define TILE_A(i, k) tileA[i][k]
+#endif
+#if TRANS_B
+#define TILE_B(k, j) tileB[j][k]
+#else
+#define TILE_B(k, j) tileB[k][j]
+#endif
+
+// Fused epilogue (EPILOGUE_* build options) adds arguments bias and residual matrix R (n x m) with its own
+// offset and ld, bias and R which aren't used can be NULL. R can be C itself with beta == 0.
+#define EPILOGUE (EPILOGUE_BIAS != BIAS_NONE || EPILOGUE_ACTIVATION != ACTIVATION_NONE || EPILOGUE_RESIDUAL)
+
+inline float Activate(const float x, const uint activation)
+{
+    if(activation == ACTIVATION_RELU)
+    {
+        return fmax(x, 0.0f);
+    }
+    if(activation == ACTIVATION_GELU)
+    {
+        return 0.5f * x * (1.0f + erf(x * M_SQRT1_2_F));
+    }
+    return x;
+}
+
+__kernel void Sgemm_general(const uint nDim, const uint kDim, const uint mDim, const float alpha,
+    const __global float* A, const uint offsetA, const uint lda,
+    const __global float* B, const uint offsetB, const uint ldb, const float beta,
+    __global float* C, const uint offsetC, const uint ldc
+#if EPILOGUE
+    , const __global float* bias, const __global float* R, const uint offsetR, const uint ldr
+#endif
+    )
+{
+    const int localCol = get_local_id(0);
+    const int localRow = get_local_id(1);
+    const int localId = localRow * REDUCED_TILE_SIZE + localCol;
+    const int groupCol = get_group_id(0) * TILE_SIZE;
+    const int groupRow = get_group_id(1) * TILE_SIZE;
+    int t, k, r, c, v;
+
+    __local float tileA[TILE_SIZE][TILE_SIZE];
+    __local float tileB[TILE_SIZE][TILE_SIZE];
+
+    float acc[WORK_PER_THREAD][WORK_PER_THREAD];
+    float privateB[WORK_PER_THREAD];
+
+    A += offsetA;
+    B += offsetB;
+    C += offsetC;
+
+    for(r = 0; r < WORK_PER_THREAD; r++)
+    {
+        for(c = 0; c < WORK_PER_THREAD; c++)
+        {
+            acc[r][c] = 0.0f;
+        }
+    }
+
+    for(t = 0; t < kDim; t += TILE_SIZE)
+    {
+        for(v = localId; v < TILE_SIZE * TILE_SIZE / VECTOR_WIDTH; v += REDUCED_TILE_SIZE * REDUCED_TILE_SIZE)
+        {
+            int row = v / (TILE_SIZE / VECTOR_WIDTH);
+            int col = (v % (TILE_SIZE / VECTOR_WIDTH)) * VECTOR_WIDTH;
+#if TRANS_A
+            CopyToLocal(A, kDim, nDim, lda, t + row, groupRow + col, &tileA[row][col]);
+#else
+            CopyToLocal(A, nDim, kDim, lda, groupRow + row, t + col, &tileA[row][col]);
+#endif
+#if TRANS_B
+            CopyToLocal(B, mDim, kDim, ldb, groupCol + row, t + col, &tileB[row][col]);
+#else
+            CopyToLocal(B, kDim, mDim, ldb, t + row, groupCol + col, &tileB[row][col]);
+#endif
+        }
+
+        // Wait for all work items in group.
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        #pragma unroll UNROLL
+        for(k = 0; k < TILE_SIZE; k++)
+        {
+            for(c = 0; c < WORK_PER_THREAD; c++)
+            {
+                privateB[c] = TILE_B(k, localCol + c * REDUCED_TILE_SIZE);
+            }
+
+            for(r = 0; r < WORK_PER_THREAD; r++)
+            {
+                float valueA = TILE_A(localRow + r * REDUCED_TILE_SIZE, k);
+                for(c = 0; c < WORK_PER_THREAD; c++)
+                {
+                    acc[r][c] += valueA * privateB[c];
+                }
+            }
+        }
+
+        // Tiles can't be overwritten until every work item is done with them.
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    // With beta == 0 C is only written, as in BLAS (uninitialized C can contain NaN).
+    for(r = 0; r < WORK_PER_THREAD; r++)
+    {
+        int i = groupRow + localRow + r * REDUCED_TILE_SIZE;
+        for(c = 0; c < WORK_PER_THREAD; c++)
+        {
+            int j = groupCol + localCol + c * REDUCED_TILE_SIZE;
+            if(i < nDim && j < mDim)
+            {
+                float value = (beta == 0.0f) ? alpha * acc[r][c] : alpha * acc[r][c] + beta * C[i*ldc + j];
+#if EPILOGUE_BIAS == BIAS_COLUMN
+                value += bias[j];
+#elif EPILOGUE_BIAS == BIAS_ROW
+                value += bias[i];
+#endif
+                value = Activate(value, EPILOGUE_ACTIVATION);
+#if EPILOGUE_RESIDUAL
+                value += R[offsetR + i*ldr + j];
+#endif
+                C[i*ldc + j] = value;
+            }
+        }
+    }
+}
+
+// Z = X + beta * Y for blocks (rows x cols) of matrices with their own offsets and distances between rows
+// (as in Sgemm_general), Z can be X or Y. Combines quadrants in Strassen-Winograd SGEMM, beta is 1 or -1.
+__kernel void Sgeam(const uint rows, const uint cols,
+    const __global float* X, const uint offsetX, const uint ldx, const float beta,
+    const __global float* Y, const uint offsetY, const uint ldy,
+    __global float* Z, const uint offsetZ, const uint ldz)
+{
+    const int j = get_global_id(0);
+    const int i = get_global_id(1);
+
+    if(i < rows && j < cols)
+    {
+        Z[offsetZ + i*ldz + j] = X[offsetX + i*ldx + j] + beta * Y[offsetY + i*ldy + j];
+    }
+}
+
+// Kernels of blocked LU and Cholesky, they work in place on blocks of A (n x n, distance between rows lda)
+// given by offsets in floats. Triangular factors of diagonal blocks (b x b, b <= FACTOR_BLOCK) come from host.
+
+// Loads diagonal block L (b x b) into local memory, shared by all work items of the group.
+// L has rows of FACTOR_BLOCK values.
+inline void LoadTriangle(const __global float* A, const uint lda, const uint offsetL, const uint b, __local float* L)
+{
+    int v;
+    for(v = get_local_id(0); v < b * b; v += get_local_size(0))
+    {
+        L[(v / b)*FACTOR_BLOCK + v % b] = A[offsetL + (v / b)*lda + v % b];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+// Cholesky: X (rows x b) = X * L^-T for lower triangular L, every work item solves one row of X.
+__kernel void Trsm_right_lower_transposed(const uint rows, const uint b, __global float* A, const uint lda,
+    const uint offsetL, const uint offsetX)
+{
+    const int row = get_global_id(0);
+    int c, p;
+    float x[FACTOR_BLOCK];
+
+    __local float L[FACTOR_BLOCK * FACTOR_BLOCK];
+    LoadTriangle(A, lda, offsetL, b, L);
+
+    if(row < rows)
+    {
+        __global float* rowX = A + offsetX + (size_t)row * lda;
+        for(c = 0; c < b; c++)
+        {
+            float value = rowX[c];
+            for(p = 0; p < c; p++)
+            {
+                value -= x[p] * L[c*FACTOR_BLOCK + p];
+            }
+            x[c] = value / L[c*FACTOR_BLOCK + c];
+            rowX[c] = x[c];
+        }
+    }
+}
+
+// LU: X (b x cols) = L^-1 * X for unit lower triangular L, every work item solves one column of X.
+__kernel void Trsm_left_lower_unit(const uint b, const uint cols, __global float* A, const uint lda,
+    const uint offsetL, const uint offsetX)
+{
+    const int col = get_global_id(0);
+    int r, p;
+    float x[FACTOR_BLOCK];
+
+    __local float L[FACTOR_BLOCK * FACTOR_BLOCK];
+    LoadTriangle(A, lda, offsetL, b, L);
+
+    if(col < cols)
+    {
+        __global float* colX = A + offsetX + col;
+        for(r = 0; r < b; r++)
+        {
+            float value = colX[r*lda];
+            for(p = 0; p < r; p++)
+            {
+                value -= L[r*FACTOR_BLOCK + p] * x[p];
+            }
+            x[r] = value;
+            colX[r*lda] = value;
+        }
+    }
+}
+
+// Cholesky: lower triangle of C (n x n) -= X * X^T for X (n x k), both blocks of A. Work group computes FACTOR_TILE x FACTOR_TILE
+// block of C, groups above the diagonal end at once. Rows of X for the block's rows and columns pass through
+// local memory (padded against bank conflicts, tileJ is read by columns).
+__kernel void Syrk_lower(const uint nDim, const uint kDim, __global float* A, const uint lda,
+    const uint offsetX, const uint offsetC)
+{
+    const int localCol = get_local_id(0);
+    const int localRow = get_local_id(1);
+    const int groupCol = get_group_id(0) * FACTOR_TILE;
+    const int groupRow = get_group_id(1) * FACTOR_TILE;
+    const int i = groupRow + localRow;
+    const int j = groupCol + localCol;
+    int t, c;
+    float acc = 0.0f;
+
+    __local float tileI[FACTOR_TILE][FACTOR_TILE + 1];
+    __local float tileJ[FACTOR_TILE][FACTOR_TILE + 1];
+
+    if(groupCol > groupRow)
+    {
+        return;
+    }
+
+    const __global float* X = A + offsetX;
+    __global float* C = A + offsetC;
+
+    for(t = 0; t < kDim; t += FACTOR_TILE)
+    {
+        const int k = t + localCol;
+        tileI[localRow][localCol] = (groupRow + localRow < nDim && k < kDim) ? X[(groupRow + localRow)*lda + k] : 0.0f;
+        tileJ[localRow][localCol] = (groupCol + localRow < nDim && k < kDim) ? X[(groupCol + localRow)*lda + k] : 0.0f;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for(c = 0; c < FACTOR_TILE; c++)
+        {
+            acc += tileI[localRow][c] * tileJ[localCol][c];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if(i < nDim && j <= i)
+    {
+        C[i*lda + j] -= acc;
+    }
+}
+
+// LU: row interchanges first + p <-> pivots[p] (absolute rows) for p = 0 .. count - 1 in this order,
+// in all columns except the panel [skipBegin, skipEnd) which host has already swapped. One work item per column.
+__kernel void Laswp(const uint cols, __global float* A, const uint lda, const __global uint* pivots,
+    const uint first, const uint count, const uint skipBegin, const uint skipEnd)
+{
+    const int j = get_global_id(0);
+    int p;
+
+    if(j < cols && (j < skipBegin || j >= skipEnd))
+    {
+        for(p = 0; p < count; p++)
+        {
+            const uint r = first + p;
+            const uint q = pivots[p];
+            if(q != r)
+            {
+                float value = A[r*lda + j];
+                A[r*lda + j] = A[q*lda + j];
+                A[q*lda + j] = value;
+            }
+        }
+    }
+}
+
+// Element-wise passes over C (rows x cols, stored contiguously) which the fused epilogue of Sgemm_general replaces.
+// Every pass reads and writes entire C again, one work item per value.
+__kernel void Bias_add(const uint rows, const uint cols, const uint biasKind, __global float* C, const __global float* bias)
+{
+    const size_t id = get_global_id(0);
+    if(id < (size_t)rows * cols)
+    {
+        C[id] += bias[biasKind == BIAS_ROW ? id / cols : id % cols];
+    }
+}
+
+__kernel void Activation(const uint count, const uint activation, __global float* C)
+{
+    const size_t id = get_global_id(0);
+    if(id < count)
+    {
+        C[id] = Activate(C[id], activation);
+    }
+}
+
+__kernel void Residual_add(const uint count, __global float* C, const __global float* R)
+{
+    const size_t id = get_global_id(0);
+    if(id < count)
+    {
+        C[id] += R[id];
+    }
+}
+
+// Sparse A (n x k) in CSR format times dense B (k x m): row i of A has values[p] in columns[p]
+// for p from rowOffsets[i] to rowOffsets[i + 1]. Every work group computes whole rows of C,
+// its work items neighbouring columns, and non-zero values of the row pass through local memory.
+// Lengths of rows can be very different, so work groups take rows from the shared counter nextRow
+// (zero before the launch) until all are done, in rowOrder which has the longest rows first.
+__kernel void Spmm_csr(const uint nDim, const uint mDim,
+    const __global uint* rowOffsets, const __global uint* columns, const __global float* values,
+    const __global uint* rowOrder, volatile __global uint* nextRow,
+    const __global float* B, __global float* C)
+{
+    const int localId = get_local_id(0);
+    int base, p, q;
+
+    __local uint sharedRow;
+    __local uint localColumns[SPARSE_CHUNK];
+    __local float localValues[SPARSE_CHUNK];
+
+    for(;;)
+    {
+        if(localId == 0)
+        {
+            sharedRow = atomic_inc(nextRow);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        const uint next = sharedRow;
+        // sharedRow can't be overwritten until every work item has read it.
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if(next >= nDim)
+        {
+            return;
+        }
+
+        const uint i = rowOrder[next];
+        const uint begin = rowOffsets[i];
+        const uint end = rowOffsets[i + 1];
+
+        for(base = 0; base < mDim; base += SPARSE_LOCAL_SIZE)
+        {
+            const int j = base + localId;
+            float acc = 0.0f;
+
+            for(p = begin; p < end; p += SPARSE_CHUNK)
+            {
+                const int count = min((uint)SPARSE_CHUNK, end - p);
+                for(q = localId; q < count; q += SPARSE_LOCAL_SIZE)
+                {
+                    localColumns[q] = columns[p + q];
+                    localValues[q] = values[p + q];
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+
+                if(j < mDim)
+                {
+                    for(q = 0; q < count; q++)
+                    {
+                        acc += localValues[q] * B[localColumns[q]*mDim + j];
+                    }
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+            }
+
+            if(j < mDim)
+            {
+                C[i*mDim + j] = acc;
+            }
+        }
+    }
+}
+
+// Quantized GEMM: A (n x k) and BT (m x k, B stored by columns as weights usually are) hold int8 values,
+// real values are scaleA[i] * (A[i][k] - zeroA[i]) and scaleB[j] * (BT[j][k] - zeroB[j]).
+// Both are read along K as char4 vectors and products are accumulated in int32 (exact while K <= QUANT_MAX_K,
+// about 2^31 / 255^2, the sum of the four lanes is int too). Every work group computes QUANT_TILE_SIZE x QUANT_TILE_SIZE
+// block of C, one value per work item, rows of A and BT pass through local memory in slices of QUANT_TILE_K values.
+#define QUANT_VECTORS (QUANT_TILE_K / 4)
+
+// Loads 4 values of row of M (rows x cols), values after the last column are replaced by zero point
+// of the row, so they add nothing to the dot product.
+inline char4 LoadChar4(const __global char* M, const uint rows, const uint cols, const int row, const int col,
+    const __global int* zero)
+{
+    char values[4];
+    int e;
+    if(row >= rows)
+    {
+        return (char4)(0);
+    }
+    if(col + 4 <= cols)
+    {
+        return vload4(0, M + (size_t)row*cols + col);
+    }
+    for(e = 0; e < 4; e++)
+    {
+        values[e] = (col + e < cols) ? M[(size_t)row*cols + col + e] : (char)zero[row];
+    }
+    return vload4(0, values);
+}
+
+inline int QuantizedDot(const uint nDim, const uint kDim, const uint mDim,
+    const __global char* A, const __global char* BT, const __global int* zeroA, const __global int* zeroB,
+    __local char4* tileA, __local char4* tileB)
+{
+    const int localCol = get_local_id(0);
+    const int localRow = get_local_id(1);
+    const int localId = localRow * QUANT_TILE_SIZE + localCol;
+    const int groupRowA = get_group_id(1) * QUANT_TILE_SIZE;
+    const int groupRowB = get_group_id(0) * QUANT_TILE_SIZE;
+    const int i = groupRowA + localRow;
+    const int j = groupRowB + localCol;
+    int t, q, v;
+    int4 acc = (int4)(0);
+
+    const int zA = (i < nDim) ? zeroA[i] : 0;
+    const int zB = (j < mDim) ? zeroB[j] : 0;
+
+    for(t = 0; t < kDim; t += QUANT_TILE_K)
+    {
+        // Rows of tiles are padded by one vector, so work items of one row read different local memory banks.
+        for(v = localId; v < QUANT_TILE_SIZE * QUANT_VECTORS; v += QUANT_TILE_SIZE * QUANT_TILE_SIZE)
+        {
+            int row = v / QUANT_VECTORS;
+            int slice = v % QUANT_VECTORS;
+            tileA[row * (QUANT_VECTORS + 1) + slice] = LoadChar4(A, nDim, kDim, groupRowA + row, t + slice * 4, zeroA);
+            tileB[row * (QUANT_VECTORS + 1) + slice] = LoadChar4(BT, mDim, kDim, groupRowB + row, t + slice * 4, zeroB);
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for(q = 0; q < QUANT_VECTORS; q++)
+        {
+            int4 a = convert_int4(tileA[localRow * (QUANT_VECTORS + 1) + q]) - zA;
+            int4 b = convert_int4(tileB[localCol * (QUANT_VECTORS + 1) + q]) - zB;
+            acc += a * b;
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    return acc.x + acc.y + acc.z + acc.w;
+}
+
+// Float output: C[i][j] = scaleA[i] * scaleB[j] * dot.
+__kernel void Gemm_int8_float(const uint nDim, const uint kDim, const uint mDim,
+    const __global char* A, const __global char* BT,
+    const __global float* scaleA, const __global int* zeroA, const __global float* scaleB, const __global int* zeroB,
+    __global float* C)
+{
+    const int i = get_global_id(1);
+    const int j = get_global_id(0);
+
+    __local char4 tileA[QUANT_TILE_SIZE * (QUANT_VECTORS + 1)];
+    __local char4 tileB[QUANT_TILE_SIZE * (QUANT_VECTORS + 1)];
+
+    int dot = QuantizedDot(nDim, kDim, mDim, A, BT, zeroA, zeroB, tileA, tileB);
+    if(i < nDim && j < mDim)
+    {
+        C[i*mDim + j] = scaleA[i] * scaleB[j] * (float)dot;
+    }
+}
+
+// Int8 output requantized with scaleC and zeroC, rounded to nearest even and saturated.
+__kernel void Gemm_int8(const uint nDim, const uint kDim, const uint mDim,
+    const __global char* A, const __global char* BT,
+    const __global float* scaleA, const __global int* zeroA, const __global float* scaleB, const __global int* zeroB,
+    const float scaleC, const int zeroC, __global char* C)
+{
+    const int i = get_global_id(1);
+    const int j = get_global_id(0);
+
+    __local char4 tileA[QUANT_TILE_SIZE * (QUANT_VECTORS + 1)];
+    __local char4 tileB[QUANT_TILE_SIZE * (QUANT_VECTORS + 1)];
+
+    int dot = QuantizedDot(nDim, kDim, mDim, A, BT, zeroA, zeroB, tileA, tileB);
+    if(i < nDim && j < mDim)
+    {
+        float value = scaleA[i] * scaleB[j] * (float)dot;
+        C[i*mDim + j] = convert_char_sat_rte(value / scaleC + (float)zeroC);
+    }
+}
+
+// Freivalds' verification of C = A * B: y = M * x and yAbs = |M| * xAbs for M (rows x cols).
+// One work group reduces one row, its REDUCTION_LOCAL_SIZE work items sum interleaved parts of the row
+// (neighbouring work items read neighbouring values) and partial sums are added in local memory.
+__kernel void Freivalds_matvec(const uint rows, const uint cols, const __global float* M,
+    const __global float* x, const __global float* xAbs, __global float* y, __global float* yAbs)
+{
+    const int row = get_group_id(0);
+    const int localId = get_local_id(0);
+    const __global float* rowM = M + (size_t)row * cols;
+    int j, s;
+    float acc = 0.0f;
+    float accAbs = 0.0f;
+
+    __local float partial[REDUCTION_LOCAL_SIZE];
+    __local float partialAbs[REDUCTION_LOCAL_SIZE];
+
+    for(j = localId; j < cols; j += REDUCTION_LOCAL_SIZE)
+    {
+        float value = rowM[j];
+        acc += value * x[j];
+        accAbs += fabs(value) * xAbs[j];
+    }
+    partial[localId] = acc;
+    partialAbs[localId] = accAbs;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(s = REDUCTION_LOCAL_SIZE / 2; s > 0; s /= 2)
+    {
+        if(localId < s)
+        {
+            partial[localId] += partial[localId + s];
+            partialAbs[localId] += partialAbs[localId + s];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if(localId == 0)
+    {
+        y[row] = partial[0];
+        yAbs[row] = partialAbs[0];
+    }
+}
@@ -0,0 +1,449 @@
+#pragma once
+
+// Shared declarations of the OpenCL SGEMM host program: shapes, launch parameters, program cache
+// and kernel wrappers implemented in host.cpp and used by other parts of the program.
+// All matrices are row-major: C (n x m) = A (n x k) * B (k x m).
+
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_TARGET_OPENCL_VERSION 200
+
+// Use opencl.hpp instead of cl2.hpp to make it clear that it supports all versions of OpenCL
+// #include <CL/cl2.hpp>
+#include <CL/opencl.hpp>
+#include <map>
+#include <string>
+#include <vector>
+#include "host.h"
+
+struct SgemmShape
+{
+	cl_uint nDim;
+	cl_uint kDim;
+	cl_uint mDim;
+};
+
+// Launch parameters of SGEMM kernels which can be tuned per device.
+// localSize is used by 1D kernels (Sgemm_compute_units, Sgemm_private, Sgemm_local),
+// 0 means default size for the device (see LocalSize1D). Tile parameters are used by Sgemm_tiled and Sgemm_general.
+// transA and transB select op(A) and op(B) of Sgemm_general, bias, activation and residual its fused epilogue
+// (see host.h), they are compiled into the program and not tuned.
+struct KernelConfig
+{
+	size_t localSize = 0;
+	cl_uint tileSize = TILE_SIZE;
+	cl_uint workPerThread = WORK_PER_THREAD;
+	cl_uint vectorWidth = VECTOR_WIDTH;
+	cl_uint unroll = UNROLL;
+	bool transA = false;
+	bool transB = false;
+	cl_uint bias = BIAS_NONE;
+	cl_uint activation = ACTIVATION_NONE;
+	bool residual = false;
+
+	bool HasEpilogue() const { return bias != BIAS_NONE || activation != ACTIVATION_NONE || residual; }
+};
+
+struct ProgramKey
+{
+	cl_device_id device;
+	std::string kernelName;
+	SgemmShape shape;
+	std::string options;
+
+	bool operator<(const ProgramKey& other) const;
+};
+
+// Programs are compiled just in time with the shape and launch parameters passed as -D build options.
+// Built programs are kept per (device, kernel, shape, options), so repeated shapes skip program.build.
+// Binaries are also kept on disk (see common/ProgramBinaryCache.h), so the next run skips compilation too.
+class ProgramCache
+{
+public:
+	ProgramCache(cl::Context& context, const std::string& kernelSource);
+
+	cl::Program& Get(cl::Device& device, const std::string& kernelName, const SgemmShape& shape,
+		const KernelConfig& config = KernelConfig(), bool printInfo = true);
+
+private:
+	cl::Context context;
+	std::string source;
+	std::map<ProgramKey, cl::Program> programs;
+};
+
+// Best launch parameters per kernel for one device, saved in TUNING_FILE as lines:
+// device name|driver version|kernel|localSize tileSize workPerThread vectorWidth unroll|time in ns
+class TuningTable
+{
+public:
+	explicit TuningTable(cl::Device& device);
+
+	void Load(const std::string& fileName);
+	void Save(const std::string& fileName) const;
+	// Default KernelConfig for kernels which weren't tuned.
+	KernelConfig Get(const std::string& kernelName) const;
+	void Set(const std::string& kernelName, const KernelConfig& config, cl_ulong elapsed);
+
+private:
+	std::string deviceName;
+	std::string driverVersion;
+	std::map<std::string, std::pair<KernelConfig, cl_ulong>> configs;
+};
+
+void FillOrdered(cl_float* matrix, cl_uint n, cl_uint m, float start, float step);
+void FillRandom(cl_float* matrix, cl_uint n, cl_uint m);
+void FillEmpty(cl_float* matrix, cl_uint n, cl_uint m);
+void SgemmNaive(const int nDim, const int mDim, const int kDim, const float* A, const float* B, float* C);
+double Gflops(const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const double elapsedNs);
+void PrintMatrix(const float* matrix, const int nDim, const int mDim);
+cl_ulong Profile(cl::Event& clEvent, bool print = true);
+size_t RoundUp(size_t value, size_t multiple);
+
+// Kernel wrappers wait for the kernel and return its execution time in ns.
+cl_ulong KernelSgemmNaive(cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, bool printInfo = true);
+cl_ulong KernelSgemmComputeUnits(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config = KernelConfig(), bool printInfo = true);
+cl_ulong KernelSgemmPrivate(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config = KernelConfig(), bool printInfo = true);
+cl_ulong KernelSgemmLocal(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config = KernelConfig(), bool printInfo = true);
+cl_ulong KernelSgemmLocalTransposed(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferBT, cl::Buffer& bufferC, const KernelConfig& config = KernelConfig(), bool printInfo = true);
+cl_ulong KernelSgemmTiled(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config = KernelConfig(), bool printInfo = true);
+// Variants with A, B and C stored as half (cl_half) on device and accumulated in float.
+cl_ulong KernelSgemmLocalHalf(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config = KernelConfig(), bool printInfo = true);
+cl_ulong KernelSgemmTiledHalf(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config = KernelConfig(), bool printInfo = true);
+// Skinny shapes (SgemmSkinny.cpp): C with at most SKINNY_MAX_DIM columns (Sgemm_tall) or rows (Sgemm_wide)
+// reduced over K by work groups. Programs have to be built for the shape (SKINNY_DIM).
+cl_ulong KernelSgemmTall(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, bool printInfo = true);
+cl_ulong KernelSgemmWide(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, bool printInfo = true);
+// y = A * x for A (n x k), Sgemm_tall built for m = 1.
+cl_ulong KernelSgemv(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, cl::Buffer& bufferA, cl::Buffer& bufferX, cl::Buffer& bufferY, bool printInfo = true);
+// Kernel which fits the shape: Sgemm_tall, Sgemm_wide or Sgemm_tiled.
+std::string SgemmKernelName(const SgemmShape& shape);
+// Runs SgemmKernelName(shape) with its program from the cache and tuned config.
+cl_ulong KernelSgemm(cl::Device& device, ProgramCache& programCache, cl::CommandQueue& commandQueue, const TuningTable& tuningTable,
+	const SgemmShape& shape, cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, bool printInfo = true);
+
+// Freivalds' verification (SgemmVerify.cpp): C = A * B is checked in O(n^2) by comparing C * r with A * (B * r)
+// for random vectors r of +1 and -1. A wrong C passes one trial with probability at most 1/2.
+struct VerifyOptions
+{
+	// 0 disables verification.
+	int trials = 0;
+	// Allowed difference relative to |A| * (|B| * |r|).
+	float tolerance = FREIVALDS_TOLERANCE;
+	bool onHost = false;
+};
+
+bool FreivaldsHost(const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	const float* A, const float* B, const float* C, const VerifyOptions& options);
+bool FreivaldsDevice(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+	const SgemmShape& shape, cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const VerifyOptions& options);
+// Run the check and print its result and time.
+void VerifyHost(const SgemmShape& shape, const float* A, const float* B, const float* C, const VerifyOptions& options);
+void VerifyDevice(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+	const SgemmShape& shape, cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const VerifyOptions& options);
+
+// BLAS SGEMM (SgemmGeneral.cpp): C = alpha * op(A) * op(B) + beta * C, where op(A) is n x k and op(B) is k x m.
+// op is taken from config.transA / config.transB, program has to be built with the same config.
+// ld* is the distance between rows of the stored matrix and offset* the position of its first value (in floats),
+// so blocks of bigger matrices can be used in place.
+cl_ulong KernelSgemmGeneral(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_float alpha,
+	cl::Buffer& bufferA, const cl_uint offsetA, const cl_uint lda,
+	cl::Buffer& bufferB, const cl_uint offsetB, const cl_uint ldb, const cl_float beta,
+	cl::Buffer& bufferC, const cl_uint offsetC, const cl_uint ldc,
+	const KernelConfig& config = KernelConfig(), bool printInfo = true);
+// Sets arguments of Sgemm_general kernel and enqueues it after events, without waiting.
+void EnqueueSgemmGeneral(cl::CommandQueue& commandQueue, cl::Kernel& kernel,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_float alpha,
+	cl::Buffer& bufferA, const cl_uint offsetA, const cl_uint lda,
+	cl::Buffer& bufferB, const cl_uint offsetB, const cl_uint ldb, const cl_float beta,
+	cl::Buffer& bufferC, const cl_uint offsetC, const cl_uint ldc,
+	const KernelConfig& config, const std::vector<cl::Event>* events = NULL, cl::Event* event = NULL);
+// The same operation on host, used to check results.
+void SgemmGeneralHost(const bool transA, const bool transB, const int nDim, const int kDim, const int mDim, const float alpha,
+	const float* A, const int lda, const float* B, const int ldb, const float beta, float* C, const int ldc);
+// Multiplies blocks inside of padded matrices with every combination of op(A) and op(B).
+void MultiplyShapeGeneral(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const KernelConfig& tunedConfig, const SgemmShape& shape);
+
+// Fused epilogue of Sgemm_general (SgemmEpilogue.cpp): bias, activation and residual selected by config
+// are applied before C is stored, instead of separate element-wise passes over C.
+// Buffers which config doesn't use can stay empty, R is n x m with its own offset and ld.
+struct EpilogueArgs
+{
+	cl::Buffer bias;
+	cl::Buffer residual;
+	cl_uint offsetR = 0;
+	cl_uint ldr = 0;
+};
+// Sets the epilogue arguments of Sgemm_general built with config.HasEpilogue(), before EnqueueSgemmGeneral.
+void SetEpilogueArgs(cl::Kernel& kernel, const EpilogueArgs& epilogue);
+cl_ulong KernelSgemmFused(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_float alpha,
+	cl::Buffer& bufferA, const cl_uint offsetA, const cl_uint lda,
+	cl::Buffer& bufferB, const cl_uint offsetB, const cl_uint ldb, const cl_float beta,
+	cl::Buffer& bufferC, const cl_uint offsetC, const cl_uint ldc,
+	const EpilogueArgs& epilogue, const KernelConfig& config, bool printInfo = true);
+// The same epilogue as separate passes (Bias_add, Activation, Residual_add) over contiguous C (n x m),
+// returns time of all passes.
+cl_ulong KernelEpilogueUnfused(cl::Program& program, cl::CommandQueue& commandQueue, const cl_uint nDim, const cl_uint mDim,
+	cl::Buffer& bufferC, const EpilogueArgs& epilogue, const KernelConfig& config, bool printInfo = true);
+void EpilogueHost(const KernelConfig& config, const int nDim, const int mDim, const float* bias,
+	const float* R, const int ldr, float* C, const int ldc);
+// Compares fused epilogues (bias per column with activation, with and without residual) with separate passes.
+void MultiplyShapeEpilogue(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const KernelConfig& tunedConfig, const SgemmShape& shape, const cl_uint activation);
+
+// Blocked LU and Cholesky (SgemmFactor.cpp) of A (n x n) in place on device. Panels of FACTOR_BLOCK columns
+// are factorized on host while the device updates the trailing matrix (TRSM, Syrk_lower and Sgemm_general),
+// the next panel is updated first, so its factorization overlaps the rest of the update (look-ahead).
+// Both return wall time in ns, panelTime gets time spent factorizing panels on host.
+// Only the lower triangle of A is read, it gets L of A = L * L^T. The upper triangle is undefined on return,
+// the look-ahead update and write-back of diagonal blocks overwrite parts of it.
+cl_ulong CholeskyBlocked(cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+	const KernelConfig& tunedConfig, const cl_uint n, cl::Buffer& bufferA, cl_ulong* panelTime = NULL);
+// P * A = L * U with partial pivoting, A gets unit lower L below the diagonal and U on and above it.
+// Row i was swapped with row pivots[i] in step i.
+cl_ulong LuBlocked(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+	const KernelConfig& tunedConfig, const cl_uint n, cl::Buffer& bufferA, std::vector<cl_uint>& pivots, cl_ulong* panelTime = NULL);
+// GFLOP/s of both factorizations relative to Sgemm_general on n x n x n and their residuals.
+void BenchmarkFactorizations(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const KernelConfig& tunedConfig, const cl_uint n);
+
+// Strassen-Winograd SGEMM (SgemmStrassen.cpp): C = A * B with levels of Winograd's variant of Strassen's algorithm
+// (7 multiplications and 15 additions of quadrants per level). Sub-products run in place on quadrants
+// through offsets and ld, every level has its own two temporary buffers reused by all its sub-products.
+// Number of levels which depth allows before blocks get smaller than STRASSEN_MIN_DIM.
+cl_uint StrassenLevels(const SgemmShape& shape, const cl_uint depth);
+// N, K and M must be divisible by 2^StrassenLevels(shape, depth). Returns sum of kernel times.
+cl_ulong SgemmStrassen(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+	const KernelConfig& tunedConfig, const SgemmShape& shape, cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC,
+	const cl_uint depth);
+// Time and error (against double on sampled rows) of classic kernels and of every depth up to maxDepth.
+void BenchmarkStrassen(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const KernelConfig& tunedConfig, const SgemmShape& shape, const cl_uint maxDepth);
+
+// Repack of B (SgemmRepack.cpp): B (k x m) is transposed on device once, so Sgemm_local_transposed
+// and Sgemm_general with TRANS_B read it contiguously along K.
+cl_ulong KernelTranspose(cl::Program& program, cl::CommandQueue& commandQueue, const cl_uint rows, const cl_uint cols,
+	cl::Buffer& bufferM, cl::Buffer& bufferMT, bool printInfo = true);
+
+// Transposed copies of B kept per source buffer, so B used by several multiplications is repacked only once.
+// Invalidate has to be called after B is rewritten.
+class RepackCache
+{
+public:
+	RepackCache(cl::Context& context, ProgramCache& programCache);
+
+	// Transposed B (m x k). elapsed gets time of the Transpose kernel, 0 when the copy was already cached.
+	cl::Buffer& Transposed(cl::Device& device, cl::CommandQueue& commandQueue, cl::Buffer& bufferB,
+		const cl_uint kDim, const cl_uint mDim, cl_ulong* elapsed = NULL);
+	void Invalidate(cl::Buffer& bufferB);
+
+private:
+	struct Entry
+	{
+		// Keeps the source alive, so its handle can't be reused by another buffer.
+		cl::Buffer source;
+		cl_uint kDim;
+		cl_uint mDim;
+		cl::Buffer transposed;
+	};
+
+	cl::Context context;
+	ProgramCache& programCache;
+	std::map<cl_mem, Entry> entries;
+};
+
+// Sgemm_local and Sgemm_general on B and on its cached transposed copy.
+void MultiplyShapeRepacked(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const SgemmShape& shape);
+
+// Mixed precision SGEMM (SgemmHalf.cpp): A and B are converted to half on host, half kernels run
+// on them and C is compared with the float result of the same kernels (maximum and RMS error).
+void MultiplyShapeHalf(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const SgemmShape& shape);
+
+// Quantized GEMM (SgemmQuantized.cpp): int8 A (n x k) and BT (m x k) with per-row scale and zero point
+// (value = scale * (q - zero)), int32 accumulation and float or requantized int8 output.
+// Quantizes rows of M (rows x cols) asymmetrically into [-128, 127]. With transpose M is stored as cols x rows
+// and its columns are quantized, so Q gets M transposed.
+void QuantizeRows(const float* M, const cl_uint rows, const cl_uint cols, const bool transpose,
+	cl_char* Q, cl_float* scale, cl_int* zero);
+void GemmInt8Host(const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_char* A, const cl_char* BT,
+	const cl_float* scaleA, const cl_int* zeroA, const cl_float* scaleB, const cl_int* zeroB, cl_float* C);
+cl_ulong KernelGemmInt8Float(cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, cl::Buffer& bufferA, cl::Buffer& bufferBT,
+	cl::Buffer& scaleA, cl::Buffer& zeroA, cl::Buffer& scaleB, cl::Buffer& zeroB, cl::Buffer& bufferC, bool printInfo = true);
+// C = saturate(round(float result / scaleC) + zeroC).
+cl_ulong KernelGemmInt8(cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, cl::Buffer& bufferA, cl::Buffer& bufferBT,
+	cl::Buffer& scaleA, cl::Buffer& zeroA, cl::Buffer& scaleB, cl::Buffer& zeroB,
+	const cl_float scaleC, const cl_int zeroC, cl::Buffer& bufferC, bool printInfo = true);
+// Quantizes random matrices, compares throughput of int8 kernels with Sgemm_tiled and reports quantization error.
+void BenchmarkQuantized(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const SgemmShape& shape);
+
+// Sparse SGEMM (SgemmSparse.cpp): A (n x k) in CSR format times dense B (k x m) with Spmm_csr.
+struct CsrMatrix
+{
+	cl_uint rows;
+	cl_uint cols;
+	std::vector<cl_uint> rowOffsets;
+	std::vector<cl_uint> columns;
+	std::vector<cl_float> values;
+	// Rows sorted by number of non-zero values, the longest first.
+	std::vector<cl_uint> rowOrder;
+};
+CsrMatrix DenseToCsr(const float* M, const cl_uint rows, const cl_uint cols);
+// Fraction of non-zero values of M.
+double Density(const float* M, const size_t count);
+
+// CSR arrays on device. Spmm_csr only reads them, so one upload serves every multiplication with A.
+struct DeviceCsr
+{
+	cl_uint rows;
+	cl_uint cols;
+	cl::Buffer rowOffsets;
+	cl::Buffer columns;
+	cl::Buffer values;
+	cl::Buffer rowOrder;
+};
+DeviceCsr UploadCsr(cl::Context& context, const CsrMatrix& csr);
+cl_ulong KernelSpmmCsr(cl::Context& context, cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const DeviceCsr& A, const cl_uint mDim, cl::Buffer& bufferB, cl::Buffer& bufferC, bool printInfo = true);
+// Multiplies dense A (host) by B on device: as CSR when density of A is at most SPARSE_MAX_DENSITY,
+// otherwise with Sgemm_tiled. isSparse gets the chosen way.
+cl_ulong MultiplyDispatched(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const SgemmShape& shape,
+	const float* A, cl::Buffer& bufferB, cl::Buffer& bufferC, bool* isSparse = NULL);
+// Compares Spmm_csr with Sgemm_local on A with decreasing density and skewed row lengths.
+void BenchmarkSparse(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const SgemmShape& shape);
+
+// Weight-stationary SGEMM (SgemmSession.cpp): B is uploaded and transposed once, then batches of A
+// (up to maxRows x k) stream through SESSION_SLOTS reused device buffers. Uploads, kernels and read backs
+// run on separate queues synchronized by events, so a batch is transferred while the previous one is computed.
+class SgemmSession
+{
+public:
+	SgemmSession(cl::Context& context, cl::Device& device, ProgramCache& programCache,
+		const KernelConfig& tunedConfig, const float* B, const cl_uint kDim, const cl_uint mDim, const cl_uint maxRows);
+	// Waits for submitted batches, errors are only printed. Call Finish() first to get them as exceptions.
+	~SgemmSession();
+
+	// Queues C (rows x m) = A (rows x k) * B without waiting and returns the event of the read back of C.
+	// A and C must stay valid until it completes. upload gets the event of the upload of A.
+	cl::Event Submit(const float* A, const cl_uint rows, float* C, cl::Event* upload = NULL);
+	// Waits for all submitted batches.
+	void Finish();
+	// Device time of the upload and the transpose of B.
+	cl_ulong SetupTime() const { return setupTime; }
+
+private:
+	struct Slot
+	{
+		cl::Buffer bufferA;
+		cl::Buffer bufferC;
+		cl::Event kernelDone;
+		cl::Event readDone;
+	};
+
+	cl::Context context;
+	cl::Device device;
+	cl::CommandQueue commandQueue;
+	cl::CommandQueue uploadQueue;
+	cl::CommandQueue readQueue;
+	cl_uint kDim;
+	cl_uint mDim;
+	cl_uint maxRows;
+	KernelConfig config;
+	cl::Kernel kernel;
+	cl::Buffer bufferBT;
+	Slot slots[SESSION_SLOTS];
+	int next;
+	cl_ulong setupTime;
+};
+
+// Streams batchCount batches of A (N x K) through one session with B (K x M).
+void RunSession(cl::Context& context, cl::Device& device, ProgramCache& programCache, const KernelConfig& tunedConfig,
+	const SgemmShape& shape, const cl_uint batchCount, const VerifyOptions& verifyOptions);
+
+// Out-of-core SGEMM (SgemmOutOfCore.cpp) for matrices which don't fit into device memory.
+// C is computed block by block, panels of A and B are streamed through a ring of device buffers
+// on a second queue and partial products over K are accumulated with Sgemm_general (beta 1).
+struct PanelSizes
+{
+	cl_uint rows;
+	cl_uint cols;
+	cl_uint depth;
+};
+
+// Whether A, B and C can be allocated on the device at once.
+bool FitsDevice(cl::Device& device, const SgemmShape& shape);
+// The biggest panels which fit into memoryLimit bytes and CL_DEVICE_MAX_MEM_ALLOC_SIZE.
+PanelSizes ChoosePanels(const SgemmShape& shape, const cl_ulong memoryLimit, const cl_ulong maxAllocSize, const cl_uint tileSize);
+// memoryLimit 0 uses half of the device global memory.
+void MultiplyShapeOutOfCore(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const KernelConfig& tunedConfig, const SgemmShape& shape, cl_ulong memoryLimit,
+	const VerifyOptions& verifyOptions);
+
+// Multi-device SGEMM (SgemmMultiDevice.cpp): rows of C are split across all devices of all platforms
+// proportionally to their throughput measured on a calibration run. Devices of one platform share
+// a context and get their rows of A and C as sub-buffers.
+void MultiplyShapeMultiDevice(const std::string& kernelSource, const SgemmShape& shape, const VerifyOptions& verifyOptions);
+
+// Zero-copy SGEMM (SgemmZeroCopy.cpp): the tiled kernel with copied buffers, with page aligned host arrays
+// (CL_MEM_USE_HOST_PTR) and with host accessible device memory (CL_MEM_ALLOC_HOST_PTR) accessed by maps.
+// Prints times of uploads and downloads in every mode and time saved against copies.
+void MultiplyShapeZeroCopy(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const KernelConfig& tunedConfig, const SgemmShape& shape, const VerifyOptions& verifyOptions);
+
+// Benchmark (SgemmBenchmark.cpp): every kernel and the host SgemmParallel on every shape,
+// median, 95th percentile and minimum of repeated runs, GFLOP/s and effective bandwidth.
+struct BenchmarkOptions
+{
+	int warmup = BENCHMARK_WARMUP;
+	int repeats = BENCHMARK_REPEATS;
+	// Only variants which names contain this text, all when empty.
+	std::string variant;
+	std::string jsonFile = BENCHMARK_JSON;
+	std::string csvFile = BENCHMARK_CSV;
+};
+
+void BenchmarkShapes(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const std::vector<SgemmShape>& shapes, const BenchmarkOptions& options);
+
+// Batched SGEMM (SgemmBatched.cpp): many matrices of the same shape multiplied in one launch.
+// Entries are either stored with constant strides or addressed by arrays of offsets, all in floats.
+cl_uint BatchTileSize(const cl_uint nDim, const cl_uint mDim);
+cl_ulong KernelSgemmBatched(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_uint batchCount,
+	cl::Buffer& bufferA, const cl_uint strideA, cl::Buffer& bufferB, const cl_uint strideB,
+	cl::Buffer& bufferC, const cl_uint strideC, bool printInfo = true);
+cl_ulong KernelSgemmBatchedOffsets(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_uint batchCount,
+	cl::Buffer& bufferA, cl::Buffer& offsetsA, cl::Buffer& bufferB, cl::Buffer& offsetsB,
+	cl::Buffer& bufferC, cl::Buffer& offsetsC, bool printInfo = true);
+// Compares one batched launch (strided and offsets) with a loop of single launches.
+void BenchmarkBatched(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const SgemmShape& shape, const cl_uint batchCount);
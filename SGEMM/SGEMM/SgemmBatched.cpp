@@ -0,0 +1,231 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "Sgemm.h"
+#include "HostSgemm.h"
+
+using namespace std;
+
+cl_uint BatchTileSize(const cl_uint nDim, const cl_uint mDim)
+{
+	return (nDim <= 8 && mDim <= 8) ? 8 : BATCH_TILE_SIZE;
+}
+
+// Whole batch in one NDRange: blocks of C in dimensions 0 and 1, batch entries in dimension 2.
+static cl::NDRange BatchedGlobal(const cl_uint nDim, const cl_uint mDim, const cl_uint batchCount)
+{
+	cl_uint tileSize = BatchTileSize(nDim, mDim);
+	return cl::NDRange(RoundUp(mDim, tileSize), RoundUp(nDim, tileSize), batchCount);
+}
+
+static cl::NDRange BatchedLocal(const cl_uint nDim, const cl_uint mDim)
+{
+	cl_uint tileSize = BatchTileSize(nDim, mDim);
+	return cl::NDRange(tileSize, tileSize, 1);
+}
+
+cl_ulong KernelSgemmBatched(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_uint batchCount,
+	cl::Buffer& bufferA, const cl_uint strideA, cl::Buffer& bufferB, const cl_uint strideB,
+	cl::Buffer& bufferC, const cl_uint strideC, bool printInfo)
+{
+	cl::Kernel kernel(program, "Sgemm_batched");
+
+	kernel.setArg(0, sizeof(cl_uint), &nDim);
+	kernel.setArg(1, sizeof(cl_uint), &kDim);
+	kernel.setArg(2, sizeof(cl_uint), &mDim);
+	kernel.setArg(3, bufferA);
+	kernel.setArg(4, sizeof(cl_uint), &strideA);
+	kernel.setArg(5, bufferB);
+	kernel.setArg(6, sizeof(cl_uint), &strideB);
+	kernel.setArg(7, bufferC);
+	kernel.setArg(8, sizeof(cl_uint), &strideC);
+
+	if (printInfo)
+	{
+		cout << "CL_KERNEL_WORK_GROUP_SIZE: " << kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) << "\n";
+		cout << "Batch tile size: " << BatchTileSize(nDim, mDim) << "\n";
+	}
+
+	cl::Event clEvent;
+
+	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, BatchedGlobal(nDim, mDim, batchCount), BatchedLocal(nDim, mDim), NULL, &clEvent);
+	clEvent.wait();
+
+	return Profile(clEvent, printInfo);
+}
+
+cl_ulong KernelSgemmBatchedOffsets(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_uint batchCount,
+	cl::Buffer& bufferA, cl::Buffer& offsetsA, cl::Buffer& bufferB, cl::Buffer& offsetsB,
+	cl::Buffer& bufferC, cl::Buffer& offsetsC, bool printInfo)
+{
+	cl::Kernel kernel(program, "Sgemm_batched_offsets");
+
+	kernel.setArg(0, sizeof(cl_uint), &nDim);
+	kernel.setArg(1, sizeof(cl_uint), &kDim);
+	kernel.setArg(2, sizeof(cl_uint), &mDim);
+	kernel.setArg(3, bufferA);
+	kernel.setArg(4, offsetsA);
+	kernel.setArg(5, bufferB);
+	kernel.setArg(6, offsetsB);
+	kernel.setArg(7, bufferC);
+	kernel.setArg(8, offsetsC);
+
+	if (printInfo)
+	{
+		cout << "CL_KERNEL_WORK_GROUP_SIZE: " << kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) << "\n";
+		cout << "Batch tile size: " << BatchTileSize(nDim, mDim) << "\n";
+	}
+
+	cl::Event clEvent;
+
+	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, BatchedGlobal(nDim, mDim, batchCount), BatchedLocal(nDim, mDim), NULL, &clEvent);
+	clEvent.wait();
+
+	return Profile(clEvent, printInfo);
+}
+
+// Compares every entry of the batch with SgemmBlocked, tolerance is relative to the magnitude of values.
+static bool CheckBatch(const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_uint batchCount,
+	const vector<cl_float>& A, const vector<cl_float>& B, const vector<cl_float>& C)
+{
+	vector<cl_float> hostC((size_t)nDim * mDim);
+	for (cl_uint b = 0; b < batchCount; b++)
+	{
+		SgemmBlocked(nDim, mDim, kDim, &A[(size_t)b * nDim * kDim], &B[(size_t)b * kDim * mDim], hostC.data());
+		const cl_float* deviceC = &C[(size_t)b * nDim * mDim];
+		for (size_t i = 0; i < hostC.size(); i++)
+		{
+			if (abs(hostC[i] - deviceC[i]) > 1e-3f * max(1.0f, abs(hostC[i])))
+			{
+				cout << "Different value in entry " << b << " on index: " << i << "\n";
+				cout << hostC[i] << " != " << deviceC[i] << "\n";
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void BenchmarkBatched(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const SgemmShape& shape, const cl_uint batchCount)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
+	cout << "Batch: " << batchCount << " x (N: " << nDim << ", K: " << kDim << ", M: " << mDim << ")\n";
+
+	const cl_uint strideA = nDim * kDim;
+	const cl_uint strideB = kDim * mDim;
+	const cl_uint strideC = nDim * mDim;
+	size_t sizeA = (size_t)batchCount * strideA * sizeof(float);
+	size_t sizeB = (size_t)batchCount * strideB * sizeof(float);
+	size_t sizeC = (size_t)batchCount * strideC * sizeof(float);
+
+	vector<cl_float> A((size_t)batchCount * strideA);
+	vector<cl_float> B((size_t)batchCount * strideB);
+	vector<cl_float> C((size_t)batchCount * strideC);
+	for (cl_uint b = 0; b < batchCount; b++)
+	{
+		FillOrdered(&A[(size_t)b * strideA], nDim, kDim, 0.001f * (b % 7 + 1), 0.0001f);
+		FillOrdered(&B[(size_t)b * strideB], kDim, mDim, 0.002f * (b % 5 + 1), -0.0001f);
+	}
+
+	cl::Buffer bufferA(context, CL_MEM_READ_ONLY, sizeA);
+	cl::Buffer bufferB(context, CL_MEM_READ_ONLY, sizeB);
+	cl::Buffer bufferC(context, CL_MEM_READ_WRITE, sizeC);
+
+	commandQueue.enqueueWriteBuffer(bufferA, true, 0, sizeA, (void*)A.data());
+	commandQueue.enqueueWriteBuffer(bufferB, true, 0, sizeB, (void*)B.data());
+
+	// Both kernels are in the same program, built once for the batch tile size of this shape.
+	cl::Program& program = programCache.Get(device, "Sgemm_batched", shape);
+	const double batchFlops = 2.0 * nDim * kDim * mDim * batchCount;
+
+	// One launch with the whole batch.
+	cout << "Batched kernel (strided):\n";
+	auto tStart = chrono::high_resolution_clock::now();
+	cl_ulong batchedElapsed = KernelSgemmBatched(device, program, commandQueue, nDim, kDim, mDim, batchCount,
+		bufferA, strideA, bufferB, strideB, bufferC, strideC);
+	auto tEnd = chrono::high_resolution_clock::now();
+	auto batchedWall = chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart).count();
+	cout << "Host time elapsed: " << batchedWall << " ns\n";
+	cout << "Kernel GFLOP/s: " << batchFlops / batchedElapsed << "\n";
+
+	commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)C.data());
+	cout << "Equality: " << boolalpha << CheckBatch(nDim, kDim, mDim, batchCount, A, B, C) << "\n";
+
+	// The same batch addressed by offsets of entries, listed in reverse order.
+	cout << "Batched kernel (offsets):\n";
+	vector<cl_uint> offsetsA(batchCount), offsetsB(batchCount), offsetsC(batchCount);
+	for (cl_uint b = 0; b < batchCount; b++)
+	{
+		cl_uint entry = batchCount - 1 - b;
+		offsetsA[b] = entry * strideA;
+		offsetsB[b] = entry * strideB;
+		offsetsC[b] = entry * strideC;
+	}
+	size_t sizeOffsets = batchCount * sizeof(cl_uint);
+	cl::Buffer bufferOffsetsA(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeOffsets, offsetsA.data());
+	cl::Buffer bufferOffsetsB(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeOffsets, offsetsB.data());
+	cl::Buffer bufferOffsetsC(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeOffsets, offsetsC.data());
+
+	commandQueue.enqueueFillBuffer(bufferC, 0.0f, 0, sizeC);
+	cl_ulong offsetsElapsed = KernelSgemmBatchedOffsets(device, program, commandQueue, nDim, kDim, mDim, batchCount,
+		bufferA, bufferOffsetsA, bufferB, bufferOffsetsB, bufferC, bufferOffsetsC);
+	cout << "Kernel GFLOP/s: " << batchFlops / offsetsElapsed << "\n";
+
+	commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)C.data());
+	cout << "Equality: " << boolalpha << CheckBatch(nDim, kDim, mDim, batchCount, A, B, C) << "\n";
+
+	// Baseline: one launch per entry. Entry is selected with global offset in dimension 2,
+	// launches are queued back to back and waited for once, so only the launch overhead differs.
+	cout << "Loop of single launches:\n";
+	cl::Kernel kernel(program, "Sgemm_batched");
+	kernel.setArg(0, sizeof(cl_uint), &nDim);
+	kernel.setArg(1, sizeof(cl_uint), &kDim);
+	kernel.setArg(2, sizeof(cl_uint), &mDim);
+	kernel.setArg(3, bufferA);
+	kernel.setArg(4, sizeof(cl_uint), &strideA);
+	kernel.setArg(5, bufferB);
+	kernel.setArg(6, sizeof(cl_uint), &strideB);
+	kernel.setArg(7, bufferC);
+	kernel.setArg(8, sizeof(cl_uint), &strideC);
+
+	cl::NDRange global = BatchedGlobal(nDim, mDim, 1);
+	cl::NDRange local = BatchedLocal(nDim, mDim);
+	vector<cl::Event> events(batchCount);
+
+	commandQueue.enqueueFillBuffer(bufferC, 0.0f, 0, sizeC);
+	commandQueue.finish();
+	tStart = chrono::high_resolution_clock::now();
+	for (cl_uint b = 0; b < batchCount; b++)
+	{
+		commandQueue.enqueueNDRangeKernel(kernel, cl::NDRange(0, 0, b), global, local, NULL, &events[b]);
+	}
+	commandQueue.finish();
+	tEnd = chrono::high_resolution_clock::now();
+	auto loopWall = chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart).count();
+
+	cl_ulong loopKernels = 0;
+	for (cl::Event& clEvent : events)
+	{
+		loopKernels += Profile(clEvent, false);
+	}
+	cl_ulong loopSpan = events.back().getProfilingInfo<CL_PROFILING_COMMAND_END>()
+		- events.front().getProfilingInfo<CL_PROFILING_COMMAND_START>();
+	cout << "Sum of kernel times: " << loopKernels << " ns\n";
+	cout << "First start to last end: " << loopSpan << " ns\n";
+	cout << "Host time elapsed: " << loopWall << " ns\n";
+	cout << "Kernel GFLOP/s: " << batchFlops / loopSpan << "\n";
+
+	commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)C.data());
+	cout << "Equality: " << boolalpha << CheckBatch(nDim, kDim, mDim, batchCount, A, B, C) << "\n";
+
+	cout << "Batched speedup (device): " << (double)loopSpan / batchedElapsed << "x\n";
+	cout << "Batched speedup (host): " << (double)loopWall / batchedWall << "x\n";
+}
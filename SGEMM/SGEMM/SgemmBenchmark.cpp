@@ -0,0 +1,229 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include "Sgemm.h"
+#include "HostSgemm.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+struct BenchmarkResult
+{
+	string variant;
+	SgemmShape shape;
+	// Empty when the variant ran, otherwise the reason why it couldn't run.
+	string error;
+	cl_ulong medianNs;
+	cl_ulong p95Ns;
+	cl_ulong minNs;
+	double gflops;
+	double bandwidth;
+};
+
+// Variant runs one multiplication and returns its time in ns (kernel time from profiling events
+// for device variants, wall time for host).
+struct BenchmarkVariant
+{
+	string name;
+	function<cl_ulong()> run;
+};
+
+// Nearest-rank percentile of sorted times.
+static cl_ulong Percentile(const vector<cl_ulong>& sorted, double percent)
+{
+	size_t rank = (size_t)(percent / 100.0 * sorted.size() + 0.999999);
+	return sorted[min(max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+static BenchmarkResult Measure(const BenchmarkVariant& variant, const SgemmShape& shape, const BenchmarkOptions& options)
+{
+	BenchmarkResult result{ variant.name, shape, "", 0, 0, 0, 0.0, 0.0 };
+	vector<cl_ulong> times;
+	try
+	{
+		for (int run = 0; run < options.warmup; run++)
+		{
+			variant.run();
+		}
+		for (int run = 0; run < options.repeats; run++)
+		{
+			times.push_back(variant.run());
+		}
+	}
+	catch (cl::Error& e)
+	{
+		result.error = string(e.what()) + " (" + to_string(e.err()) + ")";
+		return result;
+	}
+
+	sort(times.begin(), times.end());
+	result.medianNs = times[times.size() / 2];
+	result.p95Ns = Percentile(times, 95.0);
+	result.minNs = times.front();
+	result.gflops = Gflops(shape.nDim, shape.kDim, shape.mDim, (double)result.medianNs);
+	// Effective bandwidth counts every matrix read or written once (GB/s = bytes per ns).
+	double bytes = ((double)shape.nDim * shape.kDim + (double)shape.kDim * shape.mDim + (double)shape.nDim * shape.mDim) * sizeof(float);
+	result.bandwidth = bytes / result.medianNs;
+	return result;
+}
+
+static string JsonString(const string& text)
+{
+	string escaped = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			escaped += '\\';
+		}
+		escaped += (c == '\n' || c == '\r') ? ' ' : c;
+	}
+	return escaped + "\"";
+}
+
+static void WriteJson(const string& fileName, cl::Device& device, const BenchmarkOptions& options, const vector<BenchmarkResult>& results)
+{
+	ofstream file(fileName, ios::trunc);
+	file << "{\n";
+	file << "  \"device\": " << JsonString(device.getInfo<CL_DEVICE_NAME>()) << ",\n";
+	file << "  \"driver\": " << JsonString(device.getInfo<CL_DRIVER_VERSION>()) << ",\n";
+	file << "  \"host\": " << JsonString(SimdLevelName(DetectSimdLevel())) << ",\n";
+	file << "  \"threads\": " << ThreadPool::Instance().Size() << ",\n";
+	file << "  \"warmup\": " << options.warmup << ",\n";
+	file << "  \"repeats\": " << options.repeats << ",\n";
+	file << "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult& result = results[i];
+		file << "    { \"variant\": " << JsonString(result.variant)
+			<< ", \"n\": " << result.shape.nDim << ", \"k\": " << result.shape.kDim << ", \"m\": " << result.shape.mDim;
+		if (result.error.empty())
+		{
+			file << ", \"median_ns\": " << result.medianNs << ", \"p95_ns\": " << result.p95Ns << ", \"min_ns\": " << result.minNs
+				<< ", \"gflops\": " << result.gflops << ", \"bandwidth_gbs\": " << result.bandwidth;
+		}
+		else
+		{
+			file << ", \"error\": " << JsonString(result.error);
+		}
+		file << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	file << "  ]\n";
+	file << "}\n";
+}
+
+static void WriteCsv(const string& fileName, const vector<BenchmarkResult>& results)
+{
+	ofstream file(fileName, ios::trunc);
+	file << "variant,n,k,m,median_ns,p95_ns,min_ns,gflops,bandwidth_gbs,error\n";
+	for (const BenchmarkResult& result : results)
+	{
+		file << result.variant << "," << result.shape.nDim << "," << result.shape.kDim << "," << result.shape.mDim << ",";
+		if (result.error.empty())
+		{
+			file << result.medianNs << "," << result.p95Ns << "," << result.minNs << "," << result.gflops << "," << result.bandwidth << ",\n";
+		}
+		else
+		{
+			string error = result.error;
+			replace(error.begin(), error.end(), ',', ';');
+			file << ",,,,," << error << "\n";
+		}
+	}
+}
+
+void BenchmarkShapes(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const vector<SgemmShape>& shapes, const BenchmarkOptions& options)
+{
+	cout << "\nBenchmark: " << shapes.size() << " shapes, warmup: " << options.warmup << ", repeats: " << options.repeats << "\n";
+	cout << left << setw(22) << "variant" << setw(18) << "N x K x M" << right
+		<< setw(14) << "median ns" << setw(14) << "p95 ns" << setw(10) << "GFLOP/s" << setw(10) << "GB/s" << "\n";
+
+	vector<BenchmarkResult> results;
+	for (const SgemmShape& shape : shapes)
+	{
+		const cl_uint nDim = shape.nDim;
+		const cl_uint kDim = shape.kDim;
+		const cl_uint mDim = shape.mDim;
+
+		vector<cl_float> A((size_t)nDim * kDim);
+		vector<cl_float> B((size_t)kDim * mDim);
+		vector<cl_float> C((size_t)nDim * mDim);
+		FillOrdered(A.data(), nDim, kDim, 0.00001f, 0.00001f);
+		FillOrdered(B.data(), kDim, mDim, 0.00002f, 0.00002f);
+
+		size_t sizeA = A.size() * sizeof(float);
+		size_t sizeB = B.size() * sizeof(float);
+		size_t sizeC = C.size() * sizeof(float);
+		cl::Buffer bufferA(context, CL_MEM_READ_ONLY, sizeA);
+		cl::Buffer bufferB(context, CL_MEM_READ_ONLY, sizeB);
+		cl::Buffer bufferC(context, CL_MEM_READ_WRITE, sizeC);
+		commandQueue.enqueueWriteBuffer(bufferA, true, 0, sizeA, (void*)A.data());
+		commandQueue.enqueueWriteBuffer(bufferB, true, 0, sizeB, (void*)B.data());
+
+		// Programs are taken from the cache on every run, so only the first (warm up) run builds them.
+		auto program = [&](const string& kernelName) -> cl::Program&
+		{
+			return programCache.Get(device, kernelName, shape, tuningTable.Get(kernelName), false);
+		};
+
+		// B is transposed in the first (warm up) run and the copy is reused by the next ones.
+		RepackCache repackCache(context, programCache);
+
+		vector<BenchmarkVariant> variants{
+			{ "Sgemm_simple", [&]() { return KernelSgemmNaive(program("Sgemm_simple"), commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC, false); } },
+			{ "Sgemm_compute_units", [&]() { return KernelSgemmComputeUnits(device, program("Sgemm_compute_units"), commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC, tuningTable.Get("Sgemm_compute_units"), false); } },
+			{ "Sgemm_private", [&]() { return KernelSgemmPrivate(device, program("Sgemm_private"), commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC, tuningTable.Get("Sgemm_private"), false); } },
+			{ "Sgemm_local", [&]() { return KernelSgemmLocal(device, program("Sgemm_local"), commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC, tuningTable.Get("Sgemm_local"), false); } },
+			{ "Sgemm_local_transposed", [&]() { return KernelSgemmLocalTransposed(device, program("Sgemm_local_transposed"), commandQueue, nDim, kDim, mDim, bufferA,
+				repackCache.Transposed(device, commandQueue, bufferB, kDim, mDim), bufferC, tuningTable.Get("Sgemm_local_transposed"), false); } },
+			{ "Sgemm_tiled", [&]() { return KernelSgemmTiled(device, program("Sgemm_tiled"), commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC, tuningTable.Get("Sgemm_tiled"), false); } },
+			{ "Sgemm_general", [&]() { return KernelSgemmGeneral(device, programCache.Get(device, "Sgemm_general", shape, tuningTable.Get("Sgemm_tiled"), false), commandQueue,
+				nDim, kDim, mDim, 1.0f, bufferA, 0, kDim, bufferB, 0, mDim, 0.0f, bufferC, 0, mDim, tuningTable.Get("Sgemm_tiled"), false); } },
+			{ "Host_parallel", [&]()
+				{
+					auto tStart = chrono::high_resolution_clock::now();
+					SgemmParallel(nDim, mDim, kDim, A.data(), B.data(), C.data());
+					auto tEnd = chrono::high_resolution_clock::now();
+					return (cl_ulong)chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart).count();
+				} },
+		};
+
+		// Skinny kernels only exist for narrow C.
+		string skinnyKernel = SgemmKernelName(shape);
+		if (skinnyKernel != "Sgemm_tiled")
+		{
+			variants.insert(variants.end() - 1, { skinnyKernel, [&]() { return KernelSgemm(device, programCache, commandQueue, tuningTable, shape, bufferA, bufferB, bufferC, false); } });
+		}
+
+		for (const BenchmarkVariant& variant : variants)
+		{
+			if (!options.variant.empty() && variant.name.find(options.variant) == string::npos)
+			{
+				continue;
+			}
+
+			BenchmarkResult result = Measure(variant, shape, options);
+			string dimensions = to_string(nDim) + " x " + to_string(kDim) + " x " + to_string(mDim);
+			cout << left << setw(22) << result.variant << setw(18) << dimensions << right;
+			if (result.error.empty())
+			{
+				cout << setw(14) << result.medianNs << setw(14) << result.p95Ns << fixed << setprecision(2)
+					<< setw(10) << result.gflops << setw(10) << result.bandwidth << defaultfloat << "\n";
+			}
+			else
+			{
+				cout << "  skipped: " << result.error << "\n";
+			}
+			results.push_back(result);
+		}
+	}
+
+	WriteJson(options.jsonFile, device, options, results);
+	WriteCsv(options.csvFile, results);
+	cout << "Results saved to " << options.jsonFile << " and " << options.csvFile << "\n";
+}
@@ -0,0 +1,218 @@
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "Sgemm.h"
+
+using namespace std;
+
+void SetEpilogueArgs(cl::Kernel& kernel, const EpilogueArgs& epilogue)
+{
+	// Arguments follow the 14 arguments set by EnqueueSgemmGeneral.
+	kernel.setArg(14, epilogue.bias);
+	kernel.setArg(15, epilogue.residual);
+	kernel.setArg(16, sizeof(cl_uint), &epilogue.offsetR);
+	kernel.setArg(17, sizeof(cl_uint), &epilogue.ldr);
+}
+
+cl_ulong KernelSgemmFused(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_float alpha,
+	cl::Buffer& bufferA, const cl_uint offsetA, const cl_uint lda,
+	cl::Buffer& bufferB, const cl_uint offsetB, const cl_uint ldb, const cl_float beta,
+	cl::Buffer& bufferC, const cl_uint offsetC, const cl_uint ldc,
+	const EpilogueArgs& epilogue, const KernelConfig& config, bool printInfo)
+{
+	if (!config.HasEpilogue())
+	{
+		throw runtime_error("KernelSgemmFused needs config with bias, activation or residual!");
+	}
+
+	cl::Kernel kernel(program, "Sgemm_general");
+
+	if (printInfo)
+	{
+		cout << "CL_KERNEL_WORK_GROUP_SIZE: " << kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) << "\n";
+	}
+
+	cl::Event clEvent;
+
+	SetEpilogueArgs(kernel, epilogue);
+	EnqueueSgemmGeneral(commandQueue, kernel, nDim, kDim, mDim, alpha, bufferA, offsetA, lda,
+		bufferB, offsetB, ldb, beta, bufferC, offsetC, ldc, config, NULL, &clEvent);
+	clEvent.wait();
+
+	return Profile(clEvent, printInfo);
+}
+
+static cl_ulong EnqueueElementwise(cl::CommandQueue& commandQueue, cl::Kernel& kernel, const cl_uint count, bool printInfo)
+{
+	cl::NDRange global = cl::NDRange(RoundUp(count, DEFAULT_MAX_LOCAL_SIZE));
+	cl::NDRange local = cl::NDRange(DEFAULT_MAX_LOCAL_SIZE);
+	cl::Event clEvent;
+
+	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, NULL, &clEvent);
+	clEvent.wait();
+
+	return Profile(clEvent, printInfo);
+}
+
+cl_ulong KernelEpilogueUnfused(cl::Program& program, cl::CommandQueue& commandQueue, const cl_uint nDim, const cl_uint mDim,
+	cl::Buffer& bufferC, const EpilogueArgs& epilogue, const KernelConfig& config, bool printInfo)
+{
+	const cl_uint count = nDim * mDim;
+	cl_ulong elapsed = 0;
+
+	if (config.bias != BIAS_NONE)
+	{
+		cl::Kernel kernel(program, "Bias_add");
+		kernel.setArg(0, sizeof(cl_uint), &nDim);
+		kernel.setArg(1, sizeof(cl_uint), &mDim);
+		kernel.setArg(2, sizeof(cl_uint), &config.bias);
+		kernel.setArg(3, bufferC);
+		kernel.setArg(4, epilogue.bias);
+		elapsed += EnqueueElementwise(commandQueue, kernel, count, printInfo);
+	}
+	if (config.activation != ACTIVATION_NONE)
+	{
+		cl::Kernel kernel(program, "Activation");
+		kernel.setArg(0, sizeof(cl_uint), &count);
+		kernel.setArg(1, sizeof(cl_uint), &config.activation);
+		kernel.setArg(2, bufferC);
+		elapsed += EnqueueElementwise(commandQueue, kernel, count, printInfo);
+	}
+	if (config.residual)
+	{
+		// Residual_add reads R contiguously.
+		if (epilogue.offsetR != 0 || epilogue.ldr != mDim)
+		{
+			throw runtime_error("Residual_add needs R stored contiguously!");
+		}
+		cl::Kernel kernel(program, "Residual_add");
+		kernel.setArg(0, sizeof(cl_uint), &count);
+		kernel.setArg(1, bufferC);
+		kernel.setArg(2, epilogue.residual);
+		elapsed += EnqueueElementwise(commandQueue, kernel, count, printInfo);
+	}
+	return elapsed;
+}
+
+void EpilogueHost(const KernelConfig& config, const int nDim, const int mDim, const float* bias,
+	const float* R, const int ldr, float* C, const int ldc)
+{
+	for (int i = 0; i < nDim; i++)
+	{
+		for (int j = 0; j < mDim; j++)
+		{
+			float& value = C[(size_t)i * ldc + j];
+			if (config.bias != BIAS_NONE)
+			{
+				value += bias[config.bias == BIAS_ROW ? i : j];
+			}
+			if (config.activation == ACTIVATION_RELU)
+			{
+				value = max(value, 0.0f);
+			}
+			else if (config.activation == ACTIVATION_GELU)
+			{
+				value = 0.5f * value * (1.0f + erf(value * 0.70710678f));
+			}
+			if (config.residual)
+			{
+				value += R[(size_t)i * ldr + j];
+			}
+		}
+	}
+}
+
+static const char* ActivationName(const cl_uint activation)
+{
+	return activation == ACTIVATION_RELU ? "ReLU" : activation == ACTIVATION_GELU ? "GELU" : "no activation";
+}
+
+static bool EqualResults(const vector<cl_float>& expected, const vector<cl_float>& C)
+{
+	for (size_t i = 0; i < C.size(); i++)
+	{
+		if (abs(expected[i] - C[i]) > 1e-3f * max(1.0f, abs(expected[i])))
+		{
+			cout << "Different value on index: " << i << "\n";
+			cout << expected[i] << " != " << C[i] << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+void MultiplyShapeEpilogue(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const KernelConfig& tunedConfig, const SgemmShape& shape, const cl_uint activation)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
+	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << " (fused bias, " << ActivationName(activation) << ")\n";
+
+	// Layer of a network: A are activations, B weights, bias is per output feature (column of C)
+	// and R is the input of the layer skipped around it.
+	vector<cl_float> A((size_t)nDim * kDim);
+	vector<cl_float> B((size_t)kDim * mDim);
+	vector<cl_float> bias(mDim);
+	vector<cl_float> R((size_t)nDim * mDim);
+	mt19937 generator(12345);
+	uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	for (vector<cl_float>* matrix : { &A, &B, &bias, &R })
+	{
+		generate(matrix->begin(), matrix->end(), [&]() { return distribution(generator); });
+	}
+
+	size_t sizeC = (size_t)nDim * mDim * sizeof(float);
+	cl::Buffer bufferA(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, A.size() * sizeof(float), A.data());
+	cl::Buffer bufferB(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, B.size() * sizeof(float), B.data());
+	cl::Buffer bufferC(context, CL_MEM_READ_WRITE, sizeC);
+	EpilogueArgs epilogue;
+	epilogue.bias = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bias.size() * sizeof(float), bias.data());
+	epilogue.residual = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeC, R.data());
+	epilogue.ldr = mDim;
+
+	vector<cl_float> C((size_t)nDim * mDim);
+	vector<cl_float> fusedC((size_t)nDim * mDim);
+	cl::Program& elementwise = programCache.Get(device, "Bias_add", SgemmShape{ 0, 0, 0 }, KernelConfig(), false);
+
+	for (bool residual : { false, true })
+	{
+		KernelConfig config = tunedConfig;
+		config.transA = false;
+		config.transB = false;
+		config.bias = BIAS_COLUMN;
+		config.activation = activation;
+		config.residual = residual;
+
+		// Sgemm_general writes C once, then every pass reads and writes it again.
+		KernelConfig plain = config;
+		plain.bias = BIAS_NONE;
+		plain.activation = ACTIVATION_NONE;
+		plain.residual = false;
+		cl_ulong gemm = KernelSgemmGeneral(device, programCache.Get(device, "Sgemm_general", shape, plain, false), commandQueue,
+			nDim, kDim, mDim, 1.0f, bufferA, 0, kDim, bufferB, 0, mDim, 0.0f, bufferC, 0, mDim, plain, false);
+		cl_ulong passes = KernelEpilogueUnfused(elementwise, commandQueue, nDim, mDim, bufferC, epilogue, config, false);
+		commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)C.data());
+
+		cl_ulong fused = KernelSgemmFused(device, programCache.Get(device, "Sgemm_general", shape, config, false), commandQueue,
+			nDim, kDim, mDim, 1.0f, bufferA, 0, kDim, bufferB, 0, mDim, 0.0f, bufferC, 0, mDim, epilogue, config, false);
+		commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)fusedC.data());
+
+		cout << (residual ? "With residual" : "Without residual") << ": fused " << fused << " ns, separate "
+			<< gemm + passes << " ns (Sgemm_general " << gemm << " ns + element-wise passes " << passes << " ns)\n";
+		cout << "Equality: " << boolalpha << EqualResults(C, fusedC) << "\n";
+
+		if (COMPUTE_HOST)
+		{
+			vector<cl_float> hostC((size_t)nDim * mDim);
+			SgemmGeneralHost(false, false, nDim, kDim, mDim, 1.0f, A.data(), kDim, B.data(), mDim, 0.0f, hostC.data(), mDim);
+			EpilogueHost(config, nDim, mDim, bias.data(), R.data(), mDim, hostC.data(), mDim);
+			cout << "Equality with host: " << boolalpha << EqualResults(hostC, fusedC) << "\n";
+		}
+	}
+}
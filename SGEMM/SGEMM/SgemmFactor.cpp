@@ -0,0 +1,387 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "Sgemm.h"
+
+using namespace std;
+
+// Block (rows x cols at row, col) of A (n x n) on device from or into host array with rows of cols values.
+static void ReadBlock(cl::CommandQueue& commandQueue, cl::Buffer& bufferA, const cl_uint n, const cl_uint row, const cl_uint col,
+	const cl_uint rows, const cl_uint cols, float* block, bool blocking, cl::Event* event = NULL)
+{
+	commandQueue.enqueueReadBufferRect(bufferA, blocking,
+		{ col * sizeof(float), row, 0 }, { 0, 0, 0 }, { cols * sizeof(float), rows, 1 },
+		n * sizeof(float), 0, cols * sizeof(float), 0, block, NULL, event);
+}
+
+static void WriteBlock(cl::CommandQueue& commandQueue, cl::Buffer& bufferA, const cl_uint n, const cl_uint row, const cl_uint col,
+	const cl_uint rows, const cl_uint cols, const float* block)
+{
+	commandQueue.enqueueWriteBufferRect(bufferA, false,
+		{ col * sizeof(float), row, 0 }, { 0, 0, 0 }, { cols * sizeof(float), rows, 1 },
+		n * sizeof(float), 0, cols * sizeof(float), 0, block);
+}
+
+static void Enqueue1D(cl::CommandQueue& commandQueue, cl::Kernel& kernel, const cl_uint count)
+{
+	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(RoundUp(count, FACTOR_LOCAL_SIZE)), cl::NDRange(FACTOR_LOCAL_SIZE));
+}
+
+// Lower triangle of M (b x b) gets L of M = L * L^T. False when M isn't positive definite.
+static bool CholeskyBlock(float* M, const cl_uint b)
+{
+	for (cl_uint c = 0; c < b; c++)
+	{
+		float diagonal = M[c * b + c];
+		for (cl_uint p = 0; p < c; p++)
+		{
+			diagonal -= M[c * b + p] * M[c * b + p];
+		}
+		if (diagonal <= 0.0f)
+		{
+			return false;
+		}
+		M[c * b + c] = sqrt(diagonal);
+
+		for (cl_uint r = c + 1; r < b; r++)
+		{
+			float value = M[r * b + c];
+			for (cl_uint p = 0; p < c; p++)
+			{
+				value -= M[r * b + p] * M[c * b + p];
+			}
+			M[r * b + c] = value / M[c * b + c];
+		}
+	}
+	return true;
+}
+
+// LU with partial pivoting of panel P (rows x b) in place, rows of the panel are swapped as they are chosen.
+// pivots[c] gets the row (counted from first) swapped with row first + c.
+static void LuPanel(float* P, const cl_uint rows, const cl_uint b, const cl_uint first, cl_uint* pivots)
+{
+	for (cl_uint c = 0; c < b; c++)
+	{
+		cl_uint pivot = c;
+		for (cl_uint r = c + 1; r < rows; r++)
+		{
+			if (fabs(P[r * b + c]) > fabs(P[pivot * b + c]))
+			{
+				pivot = r;
+			}
+		}
+		if (P[pivot * b + c] == 0.0f)
+		{
+			throw runtime_error("Matrix is singular!");
+		}
+		pivots[c] = first + pivot;
+		if (pivot != c)
+		{
+			swap_ranges(&P[c * b], &P[c * b] + b, &P[pivot * b]);
+		}
+
+		for (cl_uint r = c + 1; r < rows; r++)
+		{
+			float factor = P[r * b + c] /= P[c * b + c];
+			for (cl_uint cc = c + 1; cc < b; cc++)
+			{
+				P[r * b + cc] -= factor * P[c * b + cc];
+			}
+		}
+	}
+}
+
+cl_ulong CholeskyBlocked(cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+	const KernelConfig& tunedConfig, const cl_uint n, cl::Buffer& bufferA, cl_ulong* panelTime)
+{
+	cl::Program& program = programCache.Get(device, "Trsm_right_lower_transposed", SgemmShape{ 0, 0, 0 }, KernelConfig(), false);
+	cl::Kernel trsm(program, "Trsm_right_lower_transposed");
+	cl::Kernel syrk(program, "Syrk_lower");
+	KernelConfig config = tunedConfig;
+	config.transA = false;
+	config.transB = true;
+	cl::Kernel gemm(programCache.Get(device, "Sgemm_general", SgemmShape{ n, n, n }, config, false), "Sgemm_general");
+	vector<cl_float> diagonal((size_t)FACTOR_BLOCK * FACTOR_BLOCK);
+	chrono::nanoseconds hostTime(0);
+
+	auto tStart = chrono::high_resolution_clock::now();
+	cl_uint b = min<cl_uint>(FACTOR_BLOCK, n);
+	ReadBlock(commandQueue, bufferA, n, 0, 0, b, b, diagonal.data(), true);
+	for (cl_uint j = 0; j < n; j += b)
+	{
+		// Diagonal block has all updates of the previous steps, the device is still busy with the rest of them.
+		b = min<cl_uint>(FACTOR_BLOCK, n - j);
+		auto tPanel = chrono::high_resolution_clock::now();
+		if (!CholeskyBlock(diagonal.data(), b))
+		{
+			throw runtime_error("Matrix isn't positive definite!");
+		}
+		hostTime += chrono::high_resolution_clock::now() - tPanel;
+		WriteBlock(commandQueue, bufferA, n, j, j, b, b, diagonal.data());
+
+		const cl_uint below = n - j - b;
+		if (below == 0)
+		{
+			break;
+		}
+
+		// L21 = A21 * L11^-T
+		const cl_uint offsetL = j * n + j;
+		const cl_uint offsetX = (j + b) * n + j;
+		trsm.setArg(0, sizeof(cl_uint), &below);
+		trsm.setArg(1, sizeof(cl_uint), &b);
+		trsm.setArg(2, bufferA);
+		trsm.setArg(3, sizeof(cl_uint), &n);
+		trsm.setArg(4, sizeof(cl_uint), &offsetL);
+		trsm.setArg(5, sizeof(cl_uint), &offsetX);
+		Enqueue1D(commandQueue, trsm, below);
+
+		// Look-ahead: the next block column is updated first and its diagonal block read back,
+		// so host factorizes it while the device updates the rest of the trailing matrix.
+		const cl_uint next = min<cl_uint>(FACTOR_BLOCK, below);
+		EnqueueSgemmGeneral(commandQueue, gemm, below, b, next, -1.0f, bufferA, offsetX, n,
+			bufferA, offsetX, n, 1.0f, bufferA, (j + b) * n + j + b, n, config);
+		cl::Event diagonalRead;
+		ReadBlock(commandQueue, bufferA, n, j + b, j + b, next, next, diagonal.data(), false, &diagonalRead);
+
+		if (below > next)
+		{
+			// A22 -= L21 * L21^T, only the lower triangle.
+			const cl_uint rest = below - next;
+			const cl_uint offsetRest = offsetX + next * n;
+			const cl_uint offsetC = (j + b + next) * n + j + b + next;
+			syrk.setArg(0, sizeof(cl_uint), &rest);
+			syrk.setArg(1, sizeof(cl_uint), &b);
+			syrk.setArg(2, bufferA);
+			syrk.setArg(3, sizeof(cl_uint), &n);
+			syrk.setArg(4, sizeof(cl_uint), &offsetRest);
+			syrk.setArg(5, sizeof(cl_uint), &offsetC);
+			cl::NDRange global = cl::NDRange(RoundUp(rest, FACTOR_TILE), RoundUp(rest, FACTOR_TILE));
+			commandQueue.enqueueNDRangeKernel(syrk, cl::NullRange, global, cl::NDRange(FACTOR_TILE, FACTOR_TILE));
+		}
+		commandQueue.flush();
+		diagonalRead.wait();
+	}
+	commandQueue.finish();
+	auto tEnd = chrono::high_resolution_clock::now();
+
+	if (panelTime)
+	{
+		*panelTime = hostTime.count();
+	}
+	return chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart).count();
+}
+
+cl_ulong LuBlocked(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+	const KernelConfig& tunedConfig, const cl_uint n, cl::Buffer& bufferA, vector<cl_uint>& pivots, cl_ulong* panelTime)
+{
+	cl::Program& program = programCache.Get(device, "Trsm_left_lower_unit", SgemmShape{ 0, 0, 0 }, KernelConfig(), false);
+	cl::Kernel trsm(program, "Trsm_left_lower_unit");
+	cl::Kernel laswp(program, "Laswp");
+	KernelConfig config = tunedConfig;
+	config.transA = false;
+	config.transB = false;
+	cl::Kernel gemm(programCache.Get(device, "Sgemm_general", SgemmShape{ n, n, n }, config, false), "Sgemm_general");
+	cl::Buffer bufferPivots(context, CL_MEM_READ_ONLY, FACTOR_BLOCK * sizeof(cl_uint));
+	vector<cl_float> panel((size_t)n * FACTOR_BLOCK);
+	pivots.resize(n);
+	chrono::nanoseconds hostTime(0);
+
+	auto tStart = chrono::high_resolution_clock::now();
+	cl_uint b = min<cl_uint>(FACTOR_BLOCK, n);
+	ReadBlock(commandQueue, bufferA, n, 0, 0, n, b, panel.data(), true);
+	for (cl_uint j = 0; j < n; j += b)
+	{
+		// Panel (rows j..n of the block column) has all updates of the previous steps.
+		b = min<cl_uint>(FACTOR_BLOCK, n - j);
+		auto tPanel = chrono::high_resolution_clock::now();
+		LuPanel(panel.data(), n - j, b, j, &pivots[j]);
+		hostTime += chrono::high_resolution_clock::now() - tPanel;
+		WriteBlock(commandQueue, bufferA, n, j, j, n - j, b, panel.data());
+
+		// Row interchanges of the panel in all other columns, the left ones keep L consistent with P * A.
+		const cl_uint skipEnd = j + b;
+		commandQueue.enqueueWriteBuffer(bufferPivots, false, 0, b * sizeof(cl_uint), &pivots[j]);
+		laswp.setArg(0, sizeof(cl_uint), &n);
+		laswp.setArg(1, bufferA);
+		laswp.setArg(2, sizeof(cl_uint), &n);
+		laswp.setArg(3, bufferPivots);
+		laswp.setArg(4, sizeof(cl_uint), &j);
+		laswp.setArg(5, sizeof(cl_uint), &b);
+		laswp.setArg(6, sizeof(cl_uint), &j);
+		laswp.setArg(7, sizeof(cl_uint), &skipEnd);
+		Enqueue1D(commandQueue, laswp, n);
+
+		const cl_uint right = n - j - b;
+		if (right == 0)
+		{
+			break;
+		}
+
+		// U12 = L11^-1 * A12
+		const cl_uint offsetL = j * n + j;
+		const cl_uint offsetU = j * n + j + b;
+		trsm.setArg(0, sizeof(cl_uint), &b);
+		trsm.setArg(1, sizeof(cl_uint), &right);
+		trsm.setArg(2, bufferA);
+		trsm.setArg(3, sizeof(cl_uint), &n);
+		trsm.setArg(4, sizeof(cl_uint), &offsetL);
+		trsm.setArg(5, sizeof(cl_uint), &offsetU);
+		Enqueue1D(commandQueue, trsm, right);
+
+		// Look-ahead: A22 -= L21 * U12 for the next panel first, host factorizes it during the rest of the update.
+		const cl_uint offsetL21 = (j + b) * n + j;
+		const cl_uint offsetA22 = (j + b) * n + j + b;
+		const cl_uint next = min<cl_uint>(FACTOR_BLOCK, right);
+		EnqueueSgemmGeneral(commandQueue, gemm, right, b, next, -1.0f, bufferA, offsetL21, n,
+			bufferA, offsetU, n, 1.0f, bufferA, offsetA22, n, config);
+		cl::Event panelRead;
+		ReadBlock(commandQueue, bufferA, n, j + b, j + b, right, next, panel.data(), false, &panelRead);
+
+		if (right > next)
+		{
+			EnqueueSgemmGeneral(commandQueue, gemm, right, b, right - next, -1.0f, bufferA, offsetL21, n,
+				bufferA, offsetU + next, n, 1.0f, bufferA, offsetA22 + next, n, config);
+		}
+		commandQueue.flush();
+		panelRead.wait();
+	}
+	commandQueue.finish();
+	auto tEnd = chrono::high_resolution_clock::now();
+
+	if (panelTime)
+	{
+		*panelTime = hostTime.count();
+	}
+	return chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart).count();
+}
+
+// ||y - w|| / (||A|| * ||x||) in maximum norms, where y = (P) A x and w is the product through the factors.
+static double Residual(const vector<cl_float>& A, const cl_uint n, const vector<double>& x, const vector<double>& y, const vector<double>& w)
+{
+	double normA = 0.0, normX = 0.0, difference = 0.0;
+	for (cl_uint i = 0; i < n; i++)
+	{
+		double rowSum = 0.0;
+		for (cl_uint j = 0; j < n; j++)
+		{
+			rowSum += fabs(A[(size_t)i * n + j]);
+		}
+		normA = max(normA, rowSum);
+		normX = max(normX, fabs(x[i]));
+		difference = max(difference, fabs(y[i] - w[i]));
+	}
+	return difference / (normA * normX);
+}
+
+static vector<double> MultiplyVector(const vector<cl_float>& A, const cl_uint n, const vector<double>& x)
+{
+	vector<double> y(n, 0.0);
+	for (cl_uint i = 0; i < n; i++)
+	{
+		for (cl_uint j = 0; j < n; j++)
+		{
+			y[i] += A[(size_t)i * n + j] * x[j];
+		}
+	}
+	return y;
+}
+
+void BenchmarkFactorizations(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const KernelConfig& tunedConfig, const cl_uint n)
+{
+	cout << "\n";
+	cout << "N: " << n << " (blocked LU and Cholesky, panels of " << FACTOR_BLOCK << " columns)\n";
+
+	size_t sizeA = (size_t)n * n * sizeof(float);
+	vector<cl_float> A((size_t)n * n);
+	vector<cl_float> factors((size_t)n * n);
+	mt19937 generator(12345);
+	uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	generate(A.begin(), A.end(), [&]() { return distribution(generator); });
+	vector<double> x(n);
+	generate(x.begin(), x.end(), [&]() { return distribution(generator); });
+
+	// Both factorizations are dominated by updates with Sgemm_general, so it is their peak.
+	cl::Buffer bufferA(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeA, A.data());
+	cl::Buffer bufferC(context, CL_MEM_READ_WRITE, sizeA);
+	KernelConfig config = tunedConfig;
+	config.transA = false;
+	config.transB = false;
+	cl::Program& general = programCache.Get(device, "Sgemm_general", SgemmShape{ n, n, n }, config, false);
+	KernelSgemmGeneral(device, general, commandQueue, n, n, n, 1.0f, bufferA, 0, n, bufferA, 0, n, 0.0f, bufferC, 0, n, config, false);
+	double peak = Gflops(n, n, n, (double)KernelSgemmGeneral(device, general, commandQueue,
+		n, n, n, 1.0f, bufferA, 0, n, bufferA, 0, n, 0.0f, bufferC, 0, n, config, false));
+	cout << "Sgemm_general GFLOP/s: " << peak << "\n";
+
+	vector<cl_uint> pivots;
+	cl_ulong panelTime = 0;
+	cl_ulong elapsed = LuBlocked(context, device, commandQueue, programCache, tunedConfig, n, bufferA, pivots, &panelTime);
+	double gflops = 2.0 / 3.0 * n * n * n / elapsed;
+	cout << "LU: " << elapsed << " ns (panels on host " << panelTime << " ns), GFLOP/s: " << gflops
+		<< " (" << 100.0 * gflops / peak << "% of SGEMM)\n";
+
+	// P * A * x = L * (U * x), rows of A * x are swapped in the order of the steps.
+	commandQueue.enqueueReadBuffer(bufferA, true, 0, sizeA, (void*)factors.data());
+	vector<double> y = MultiplyVector(A, n, x);
+	for (cl_uint i = 0; i < n; i++)
+	{
+		swap(y[i], y[pivots[i]]);
+	}
+	vector<double> z(n, 0.0), w(n, 0.0);
+	for (cl_uint i = 0; i < n; i++)
+	{
+		for (cl_uint j = i; j < n; j++)
+		{
+			z[i] += factors[(size_t)i * n + j] * x[j];
+		}
+	}
+	for (cl_uint i = 0; i < n; i++)
+	{
+		w[i] = z[i];
+		for (cl_uint j = 0; j < i; j++)
+		{
+			w[i] += factors[(size_t)i * n + j] * z[j];
+		}
+	}
+	cout << "Residual ||P A x - L U x|| / (||A|| ||x||): " << Residual(A, n, x, y, w) << "\n";
+
+	// Symmetric matrix with dominant diagonal is positive definite.
+	for (cl_uint i = 0; i < n; i++)
+	{
+		for (cl_uint j = 0; j < i; j++)
+		{
+			A[(size_t)j * n + i] = A[(size_t)i * n + j];
+		}
+		A[(size_t)i * n + i] = (float)n;
+	}
+	commandQueue.enqueueWriteBuffer(bufferA, true, 0, sizeA, (void*)A.data());
+	elapsed = CholeskyBlocked(device, commandQueue, programCache, tunedConfig, n, bufferA, &panelTime);
+	gflops = 1.0 / 3.0 * n * n * n / elapsed;
+	cout << "Cholesky: " << elapsed << " ns (panels on host " << panelTime << " ns), GFLOP/s: " << gflops
+		<< " (" << 100.0 * gflops / peak << "% of SGEMM)\n";
+
+	// A * x = L * (L^T * x)
+	commandQueue.enqueueReadBuffer(bufferA, true, 0, sizeA, (void*)factors.data());
+	y = MultiplyVector(A, n, x);
+	fill(z.begin(), z.end(), 0.0);
+	fill(w.begin(), w.end(), 0.0);
+	for (cl_uint i = 0; i < n; i++)
+	{
+		for (cl_uint j = i; j < n; j++)
+		{
+			z[i] += factors[(size_t)j * n + i] * x[j];
+		}
+	}
+	for (cl_uint i = 0; i < n; i++)
+	{
+		for (cl_uint j = 0; j <= i; j++)
+		{
+			w[i] += factors[(size_t)i * n + j] * z[j];
+		}
+	}
+	cout << "Residual ||A x - L L^T x|| / (||A|| ||x||): " << Residual(A, n, x, y, w) << "\n";
+}
@@ -0,0 +1,178 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "Sgemm.h"
+
+using namespace std;
+
+void EnqueueSgemmGeneral(cl::CommandQueue& commandQueue, cl::Kernel& kernel,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_float alpha,
+	cl::Buffer& bufferA, const cl_uint offsetA, const cl_uint lda,
+	cl::Buffer& bufferB, const cl_uint offsetB, const cl_uint ldb, const cl_float beta,
+	cl::Buffer& bufferC, const cl_uint offsetC, const cl_uint ldc,
+	const KernelConfig& config, const vector<cl::Event>* events, cl::Event* event)
+{
+	kernel.setArg(0, sizeof(cl_uint), &nDim);
+	kernel.setArg(1, sizeof(cl_uint), &kDim);
+	kernel.setArg(2, sizeof(cl_uint), &mDim);
+	kernel.setArg(3, sizeof(cl_float), &alpha);
+	kernel.setArg(4, bufferA);
+	kernel.setArg(5, sizeof(cl_uint), &offsetA);
+	kernel.setArg(6, sizeof(cl_uint), &lda);
+	kernel.setArg(7, bufferB);
+	kernel.setArg(8, sizeof(cl_uint), &offsetB);
+	kernel.setArg(9, sizeof(cl_uint), &ldb);
+	kernel.setArg(10, sizeof(cl_float), &beta);
+	kernel.setArg(11, bufferC);
+	kernel.setArg(12, sizeof(cl_uint), &offsetC);
+	kernel.setArg(13, sizeof(cl_uint), &ldc);
+
+	// The same NDRange as Sgemm_tiled.
+	cl_uint reducedTileSize = config.tileSize / config.workPerThread;
+	cl_uint tilesM = (mDim + config.tileSize - 1) / config.tileSize;
+	cl_uint tilesN = (nDim + config.tileSize - 1) / config.tileSize;
+	cl::NDRange global = cl::NDRange(tilesM * reducedTileSize, tilesN * reducedTileSize);
+	cl::NDRange local = cl::NDRange(reducedTileSize, reducedTileSize);
+
+	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, events, event);
+}
+
+cl_ulong KernelSgemmGeneral(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_float alpha,
+	cl::Buffer& bufferA, const cl_uint offsetA, const cl_uint lda,
+	cl::Buffer& bufferB, const cl_uint offsetB, const cl_uint ldb, const cl_float beta,
+	cl::Buffer& bufferC, const cl_uint offsetC, const cl_uint ldc,
+	const KernelConfig& config, bool printInfo)
+{
+	cl::Kernel kernel(program, "Sgemm_general");
+
+	if (printInfo)
+	{
+		cout << "CL_KERNEL_WORK_GROUP_SIZE: " << kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) << "\n";
+	}
+
+	cl::Event clEvent;
+
+	EnqueueSgemmGeneral(commandQueue, kernel, nDim, kDim, mDim, alpha, bufferA, offsetA, lda,
+		bufferB, offsetB, ldb, beta, bufferC, offsetC, ldc, config, NULL, &clEvent);
+	clEvent.wait();
+
+	return Profile(clEvent, printInfo);
+}
+
+void SgemmGeneralHost(const bool transA, const bool transB, const int nDim, const int kDim, const int mDim, const float alpha,
+	const float* A, const int lda, const float* B, const int ldb, const float beta, float* C, const int ldc)
+{
+	for (int i = 0; i < nDim; i++)
+	{
+		for (int j = 0; j < mDim; j++)
+		{
+			float acc = 0.0f;
+			for (int k = 0; k < kDim; k++)
+			{
+				float valueA = transA ? A[(size_t)k * lda + i] : A[(size_t)i * lda + k];
+				float valueB = transB ? B[(size_t)j * ldb + k] : B[(size_t)k * ldb + j];
+				acc += valueA * valueB;
+			}
+			float& valueC = C[(size_t)i * ldc + j];
+			valueC = (beta == 0.0f) ? alpha * acc : alpha * acc + beta * valueC;
+		}
+	}
+}
+
+// Stored matrix rows x cols placed at row 1, column 4 of a bigger matrix with 8 more columns,
+// values around it must not be changed.
+struct MatrixBlock
+{
+	cl_uint rows;
+	cl_uint cols;
+	cl_uint ld;
+	cl_uint offset;
+
+	MatrixBlock(cl_uint rows, cl_uint cols)
+		: rows(rows), cols(cols), ld(cols + 8), offset(cols + 8 + 4)
+	{
+	}
+
+	size_t Size() const
+	{
+		return (size_t)(rows + 1) * ld;
+	}
+
+	bool Contains(size_t index) const
+	{
+		return index >= offset && (index - offset) / ld < rows && (index - offset) % ld < cols;
+	}
+};
+
+void MultiplyShapeGeneral(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const KernelConfig& tunedConfig, const SgemmShape& shape)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+	const cl_float alpha = 1.5f;
+	const cl_float beta = 0.5f;
+
+	cout << "\n";
+	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << ", alpha: " << alpha << ", beta: " << beta << "\n";
+
+	for (bool transA : { false, true })
+	{
+		for (bool transB : { false, true })
+		{
+			MatrixBlock blockA = transA ? MatrixBlock(kDim, nDim) : MatrixBlock(nDim, kDim);
+			MatrixBlock blockB = transB ? MatrixBlock(mDim, kDim) : MatrixBlock(kDim, mDim);
+			MatrixBlock blockC(nDim, mDim);
+
+			vector<cl_float> A(blockA.Size());
+			vector<cl_float> B(blockB.Size());
+			vector<cl_float> C(blockC.Size());
+			FillOrdered(A.data(), blockA.rows + 1, blockA.ld, 0.00001f, 0.00001f);
+			FillOrdered(B.data(), blockB.rows + 1, blockB.ld, 0.00002f, 0.00002f);
+			FillOrdered(C.data(), blockC.rows + 1, blockC.ld, 1.0f, 0.0001f);
+
+			cout << "op(A): " << (transA ? "T" : "N") << ", op(B): " << (transB ? "T" : "N") << "\n";
+
+			size_t sizeA = A.size() * sizeof(float);
+			size_t sizeB = B.size() * sizeof(float);
+			size_t sizeC = C.size() * sizeof(float);
+			cl::Buffer bufferA(context, CL_MEM_READ_ONLY, sizeA);
+			cl::Buffer bufferB(context, CL_MEM_READ_ONLY, sizeB);
+			cl::Buffer bufferC(context, CL_MEM_READ_WRITE, sizeC);
+
+			commandQueue.enqueueWriteBuffer(bufferA, true, 0, sizeA, (void*)A.data());
+			commandQueue.enqueueWriteBuffer(bufferB, true, 0, sizeB, (void*)B.data());
+			commandQueue.enqueueWriteBuffer(bufferC, true, 0, sizeC, (void*)C.data());
+
+			KernelConfig config = tunedConfig;
+			config.transA = transA;
+			config.transB = transB;
+			cl_ulong elapsed = KernelSgemmGeneral(device, programCache.Get(device, "Sgemm_general", shape, config), commandQueue,
+				nDim, kDim, mDim, alpha, bufferA, blockA.offset, blockA.ld, bufferB, blockB.offset, blockB.ld,
+				beta, bufferC, blockC.offset, blockC.ld, config);
+			cout << "Kernel GFLOP/s: " << Gflops(nDim, kDim, mDim, (double)elapsed) << "\n";
+
+			// This mode validates op(A), op(B), ld and offsets, so the result is always compared with host,
+			// including values around the block of C which the kernel must not change.
+			vector<cl_float> hostC = C;
+			SgemmGeneralHost(transA, transB, nDim, kDim, mDim, alpha, &A[blockA.offset], blockA.ld,
+				&B[blockB.offset], blockB.ld, beta, &hostC[blockC.offset], blockC.ld);
+
+			commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)C.data());
+			bool isEqual = true;
+			for (size_t i = 0; i < C.size(); i++)
+			{
+				bool inBlock = blockC.Contains(i);
+				if (inBlock ? abs(hostC[i] - C[i]) > 1e-3f * max(1.0f, abs(hostC[i])) : hostC[i] != C[i])
+				{
+					isEqual = false;
+					cout << "Different value on index: " << i << (inBlock ? "" : " (outside of the block)") << "\n";
+					cout << hostC[i] << " != " << C[i] << "\n";
+					break;
+				}
+			}
+			cout << "Equality: " << boolalpha << isEqual << "\n";
+		}
+	}
+}
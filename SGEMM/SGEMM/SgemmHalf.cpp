@@ -0,0 +1,115 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cmath>
+#include "Sgemm.h"
+#include "HostSgemm.h"
+
+using namespace std;
+
+// Values in [-1, 1), so products and sums of random matrices stay far from the half range (65504).
+static void FillUniform(vector<cl_float>& matrix, unsigned int seed)
+{
+	mt19937 generator(seed);
+	uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	for (cl_float& value : matrix)
+	{
+		value = distribution(generator);
+	}
+}
+
+// Maximum absolute error, maximum error relative to the largest value of the float result
+// and RMS error relative to RMS of the float result.
+static void PrintAccuracy(const char* name, const vector<cl_float>& expected, const vector<cl_float>& C)
+{
+	double maxAbsolute = 0.0, maxExpected = 0.0, sumSquares = 0.0, sumExpected = 0.0;
+	for (size_t i = 0; i < C.size(); i++)
+	{
+		double difference = fabs((double)C[i] - (double)expected[i]);
+		maxAbsolute = max(maxAbsolute, difference);
+		maxExpected = max(maxExpected, fabs((double)expected[i]));
+		sumSquares += difference * difference;
+		sumExpected += (double)expected[i] * expected[i];
+	}
+	cout << name << " against float: max error " << maxAbsolute << ", max relative error " << maxAbsolute / maxExpected
+		<< ", RMS relative error " << sqrt(sumSquares / sumExpected) << "\n";
+}
+
+void MultiplyShapeHalf(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const SgemmShape& shape)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
+	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << " (half storage, float accumulation)\n";
+
+	vector<cl_float> A((size_t)nDim * kDim);
+	vector<cl_float> B((size_t)kDim * mDim);
+	vector<cl_float> C((size_t)nDim * mDim);
+	vector<cl_float> halfC((size_t)nDim * mDim);
+	FillUniform(A, 1);
+	FillUniform(B, 2);
+
+	vector<cl_half> halfA(A.size());
+	vector<cl_half> halfB(B.size());
+	vector<cl_half> storedC(C.size());
+	auto tStart = chrono::high_resolution_clock::now();
+	FloatToHalf(A.data(), halfA.data(), A.size());
+	FloatToHalf(B.data(), halfB.data(), B.size());
+	auto tEnd = chrono::high_resolution_clock::now();
+	cout << "Conversion of A and B to half (" << (HasF16c() ? "F16C" : "scalar") << "): "
+		<< chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart).count() << " ns\n";
+
+	size_t sizeA = A.size() * sizeof(float);
+	size_t sizeB = B.size() * sizeof(float);
+	size_t sizeC = C.size() * sizeof(float);
+	cl::Buffer bufferA(context, CL_MEM_READ_ONLY, sizeA);
+	cl::Buffer bufferB(context, CL_MEM_READ_ONLY, sizeB);
+	cl::Buffer bufferC(context, CL_MEM_WRITE_ONLY, sizeC);
+	cl::Buffer bufferHalfA(context, CL_MEM_READ_ONLY, sizeA / 2);
+	cl::Buffer bufferHalfB(context, CL_MEM_READ_ONLY, sizeB / 2);
+	cl::Buffer bufferHalfC(context, CL_MEM_WRITE_ONLY, sizeC / 2);
+
+	cl::Event writeA, writeB, writeHalfA, writeHalfB;
+	commandQueue.enqueueWriteBuffer(bufferA, false, 0, sizeA, (void*)A.data(), NULL, &writeA);
+	commandQueue.enqueueWriteBuffer(bufferB, false, 0, sizeB, (void*)B.data(), NULL, &writeB);
+	commandQueue.enqueueWriteBuffer(bufferHalfA, false, 0, sizeA / 2, (void*)halfA.data(), NULL, &writeHalfA);
+	commandQueue.enqueueWriteBuffer(bufferHalfB, true, 0, sizeB / 2, (void*)halfB.data(), NULL, &writeHalfB);
+	cout << "Upload of A and B: float " << Profile(writeA, false) + Profile(writeB, false)
+		<< " ns, half " << Profile(writeHalfA, false) + Profile(writeHalfB, false) << " ns\n";
+
+	KernelConfig config = tuningTable.Get("Sgemm_tiled");
+	cl_ulong elapsed = KernelSgemmTiled(device, programCache.Get(device, "Sgemm_tiled", shape, config, false), commandQueue,
+		nDim, kDim, mDim, bufferA, bufferB, bufferC, config, false);
+	cl_ulong elapsedHalf = KernelSgemmTiledHalf(device, programCache.Get(device, "Sgemm_tiled_half", shape, config, false), commandQueue,
+		nDim, kDim, mDim, bufferHalfA, bufferHalfB, bufferHalfC, config, false);
+	commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)C.data());
+	commandQueue.enqueueReadBuffer(bufferHalfC, true, 0, sizeC / 2, (void*)storedC.data());
+	HalfToFloat(storedC.data(), halfC.data(), storedC.size());
+	cout << "Sgemm_tiled GFLOP/s: " << Gflops(nDim, kDim, mDim, (double)elapsed)
+		<< ", Sgemm_tiled_half GFLOP/s: " << Gflops(nDim, kDim, mDim, (double)elapsedHalf) << "\n";
+	PrintAccuracy("Sgemm_tiled_half", C, halfC);
+
+	// Sgemm_local keeps a row of A in private memory, so it can fail to build or run for big K.
+	try
+	{
+		config = tuningTable.Get("Sgemm_local");
+		elapsed = KernelSgemmLocal(device, programCache.Get(device, "Sgemm_local", shape, config, false), commandQueue,
+			nDim, kDim, mDim, bufferA, bufferB, bufferC, config, false);
+		elapsedHalf = KernelSgemmLocalHalf(device, programCache.Get(device, "Sgemm_local_half", shape, config, false), commandQueue,
+			nDim, kDim, mDim, bufferHalfA, bufferHalfB, bufferHalfC, config, false);
+		commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)C.data());
+		commandQueue.enqueueReadBuffer(bufferHalfC, true, 0, sizeC / 2, (void*)storedC.data());
+		HalfToFloat(storedC.data(), halfC.data(), storedC.size());
+		cout << "Sgemm_local GFLOP/s: " << Gflops(nDim, kDim, mDim, (double)elapsed)
+			<< ", Sgemm_local_half GFLOP/s: " << Gflops(nDim, kDim, mDim, (double)elapsedHalf) << "\n";
+		PrintAccuracy("Sgemm_local_half", C, halfC);
+	}
+	catch (cl::Error& e)
+	{
+		cout << "Sgemm_local skipped (" << e.err() << "): " << e.what() << "\n";
+	}
+}
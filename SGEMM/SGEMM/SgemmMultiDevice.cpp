@@ -0,0 +1,285 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "Sgemm.h"
+#include "HostSgemm.h"
+
+using namespace std;
+
+// Devices of one platform share context, buffers and programs.
+struct PlatformContext
+{
+	cl::Context context;
+	ProgramCache programCache;
+	cl_uint firstRow;
+	cl_uint lastRow;
+	cl::Buffer bufferA;
+	cl::Buffer bufferB;
+	cl::Buffer bufferC;
+};
+
+struct DeviceShare
+{
+	cl::Device device;
+	size_t platformIndex;
+	cl::CommandQueue commandQueue;
+	double calibrationGflops;
+	cl_uint firstRow;
+	cl_uint rows;
+	cl::Buffer bufferA;
+	cl::Buffer bufferC;
+	cl::Event kernelDone;
+	cl::Event readDone;
+};
+
+static size_t Gcd(size_t a, size_t b)
+{
+	while (b != 0)
+	{
+		size_t rest = a % b;
+		a = b;
+		b = rest;
+	}
+	return a;
+}
+
+// Number of rows such that sub-buffers of A (rows x k) and C (rows x m) starting at its multiples
+// are aligned to CL_DEVICE_MEM_BASE_ADDR_ALIGN of the device.
+static size_t RowGranularity(cl::Device& device, const SgemmShape& shape)
+{
+	size_t alignment = device.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>() / 8;
+	size_t rowsA = alignment / Gcd(alignment, shape.kDim * sizeof(float));
+	size_t rowsC = alignment / Gcd(alignment, shape.mDim * sizeof(float));
+	return rowsA / Gcd(rowsA, rowsC) * rowsC;
+}
+
+// Runs Sgemm_general on MULTI_DEVICE_CALIBRATION_DIM square matrices (after one warm up run)
+// and returns GFLOP/s of the device, 0 when the kernel can't run on it.
+static double Calibrate(PlatformContext& platform, DeviceShare& share)
+{
+	const cl_uint dim = MULTI_DEVICE_CALIBRATION_DIM;
+	SgemmShape shape{ dim, dim, dim };
+	size_t size = (size_t)dim * dim * sizeof(float);
+
+	try
+	{
+		cl::Buffer bufferA(platform.context, CL_MEM_READ_ONLY, size);
+		cl::Buffer bufferB(platform.context, CL_MEM_READ_ONLY, size);
+		cl::Buffer bufferC(platform.context, CL_MEM_WRITE_ONLY, size);
+		share.commandQueue.enqueueFillBuffer(bufferA, 1.0f, 0, size);
+		share.commandQueue.enqueueFillBuffer(bufferB, 1.0f, 0, size);
+		share.commandQueue.finish();
+
+		cl::Program& program = platform.programCache.Get(share.device, "Sgemm_general", shape, KernelConfig(), false);
+		cl_ulong elapsed = 0;
+		for (int run = 0; run < 2; run++)
+		{
+			elapsed = KernelSgemmGeneral(share.device, program, share.commandQueue, dim, dim, dim,
+				1.0f, bufferA, 0, dim, bufferB, 0, dim, 0.0f, bufferC, 0, dim, KernelConfig(), false);
+		}
+		return Gflops(dim, dim, dim, (double)elapsed);
+	}
+	catch (cl::Error& e)
+	{
+		cout << "  calibration failed (" << e.err() << "): " << e.what() << "\n";
+		return 0.0;
+	}
+}
+
+void MultiplyShapeMultiDevice(const string& kernelSource, const SgemmShape& shape, const VerifyOptions& verifyOptions)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
+	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << " (multi-device)\n";
+
+	vector<PlatformContext> platforms;
+	vector<DeviceShare> shares;
+
+	vector<cl::Platform> allPlatforms;
+	cl::Platform::get(&allPlatforms);
+	for (cl::Platform& platform : allPlatforms)
+	{
+		vector<cl::Device> devices;
+		try
+		{
+			platform.getDevices(CL_DEVICE_TYPE_ALL, &devices);
+		}
+		catch (cl::Error&)
+		{
+			// Platform without devices.
+			continue;
+		}
+		if (devices.empty())
+		{
+			continue;
+		}
+
+		cl::Context context(devices);
+		platforms.push_back({ context, ProgramCache(context, kernelSource), 0, 0, cl::Buffer(), cl::Buffer(), cl::Buffer() });
+		for (cl::Device& device : devices)
+		{
+			DeviceShare share{ device, platforms.size() - 1, cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE),
+				0.0, 0, 0, cl::Buffer(), cl::Buffer(), cl::Event(), cl::Event() };
+			cout << "Device: " << device.getInfo<CL_DEVICE_NAME>() << " (" << platform.getInfo<CL_PLATFORM_NAME>() << ")\n";
+
+			share.calibrationGflops = Calibrate(platforms.back(), share);
+			cout << "  calibration GFLOP/s: " << share.calibrationGflops << "\n";
+			if (share.calibrationGflops > 0.0)
+			{
+				shares.push_back(share);
+			}
+		}
+	}
+	if (shares.empty())
+	{
+		throw runtime_error("No OpenCL device can run SGEMM kernels!");
+	}
+
+	// Rows of C are split proportionally to the measured throughput. Boundaries are multiples
+	// of the granularity required by sub-buffer alignment of every device.
+	size_t granularity = 1;
+	double totalGflops = 0.0;
+	for (DeviceShare& share : shares)
+	{
+		size_t rows = RowGranularity(share.device, shape);
+		granularity = granularity / Gcd(granularity, rows) * rows;
+		totalGflops += share.calibrationGflops;
+	}
+
+	double cumulativeGflops = 0.0;
+	cl_uint firstRow = 0;
+	for (size_t d = 0; d < shares.size(); d++)
+	{
+		cumulativeGflops += shares[d].calibrationGflops;
+		cl_uint lastRow = nDim;
+		if (d + 1 < shares.size())
+		{
+			size_t boundary = (size_t)(nDim * cumulativeGflops / totalGflops / granularity + 0.5) * granularity;
+			lastRow = (cl_uint)min<size_t>(max<size_t>(boundary, firstRow), nDim);
+		}
+		shares[d].firstRow = firstRow;
+		shares[d].rows = lastRow - firstRow;
+		firstRow = lastRow;
+	}
+
+	cl_float* A = new cl_float[(size_t)nDim * kDim];
+	cl_float* B = new cl_float[(size_t)kDim * mDim];
+	cl_float* C = new cl_float[(size_t)nDim * mDim];
+
+	FillOrdered(A, nDim, kDim, 0.00001f, 0.00001f);
+	FillOrdered(B, kDim, mDim, 0.00002f, 0.00002f);
+
+	// Every context gets whole B and rows of A and C of its devices, devices use sub-buffers of them.
+	for (size_t p = 0; p < platforms.size(); p++)
+	{
+		PlatformContext& platform = platforms[p];
+		platform.firstRow = nDim;
+		platform.lastRow = 0;
+		cl::CommandQueue* uploadQueue = nullptr;
+		for (DeviceShare& share : shares)
+		{
+			if (share.platformIndex == p && share.rows != 0)
+			{
+				platform.firstRow = min(platform.firstRow, share.firstRow);
+				platform.lastRow = max(platform.lastRow, share.firstRow + share.rows);
+				uploadQueue = uploadQueue ? uploadQueue : &share.commandQueue;
+			}
+		}
+		if (uploadQueue == nullptr)
+		{
+			continue;
+		}
+
+		cl_uint rows = platform.lastRow - platform.firstRow;
+		size_t sizeA = (size_t)rows * kDim * sizeof(float);
+		size_t sizeB = (size_t)kDim * mDim * sizeof(float);
+		size_t sizeC = (size_t)rows * mDim * sizeof(float);
+		platform.bufferA = cl::Buffer(platform.context, CL_MEM_READ_ONLY, sizeA);
+		platform.bufferB = cl::Buffer(platform.context, CL_MEM_READ_ONLY, sizeB);
+		platform.bufferC = cl::Buffer(platform.context, CL_MEM_WRITE_ONLY, sizeC);
+		uploadQueue->enqueueWriteBuffer(platform.bufferA, true, 0, sizeA, (void*)(A + (size_t)platform.firstRow * kDim));
+		uploadQueue->enqueueWriteBuffer(platform.bufferB, true, 0, sizeB, (void*)B);
+
+		for (DeviceShare& share : shares)
+		{
+			if (share.platformIndex != p || share.rows == 0)
+			{
+				continue;
+			}
+			cl_buffer_region regionA{ (size_t)(share.firstRow - platform.firstRow) * kDim * sizeof(float), (size_t)share.rows * kDim * sizeof(float) };
+			cl_buffer_region regionC{ (size_t)(share.firstRow - platform.firstRow) * mDim * sizeof(float), (size_t)share.rows * mDim * sizeof(float) };
+			share.bufferA = platform.bufferA.createSubBuffer(CL_MEM_READ_ONLY, CL_BUFFER_CREATE_TYPE_REGION, &regionA);
+			share.bufferC = platform.bufferC.createSubBuffer(CL_MEM_WRITE_ONLY, CL_BUFFER_CREATE_TYPE_REGION, &regionC);
+		}
+	}
+
+	// All devices compute at once, then every device reads its rows of C.
+	auto tStart = chrono::high_resolution_clock::now();
+	for (DeviceShare& share : shares)
+	{
+		if (share.rows == 0)
+		{
+			continue;
+		}
+		PlatformContext& platform = platforms[share.platformIndex];
+		cl::Kernel kernel(platform.programCache.Get(share.device, "Sgemm_general", shape, KernelConfig(), false), "Sgemm_general");
+		EnqueueSgemmGeneral(share.commandQueue, kernel, share.rows, kDim, mDim, 1.0f, share.bufferA, 0, kDim,
+			platform.bufferB, 0, mDim, 0.0f, share.bufferC, 0, mDim, KernelConfig(), NULL, &share.kernelDone);
+		share.commandQueue.enqueueReadBuffer(share.bufferC, false, 0, (size_t)share.rows * mDim * sizeof(float),
+			(void*)(C + (size_t)share.firstRow * mDim), NULL, &share.readDone);
+		share.commandQueue.flush();
+	}
+	for (DeviceShare& share : shares)
+	{
+		share.commandQueue.finish();
+	}
+	auto tEnd = chrono::high_resolution_clock::now();
+	auto ns_int = chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart);
+
+	for (DeviceShare& share : shares)
+	{
+		cout << share.device.getInfo<CL_DEVICE_NAME>() << ": rows " << share.firstRow << " - " << share.firstRow + share.rows;
+		if (share.rows != 0)
+		{
+			cl_ulong elapsed = Profile(share.kernelDone, false);
+			cout << ", kernel: " << elapsed << " ns, GFLOP/s: " << Gflops(share.rows, kDim, mDim, (double)elapsed);
+		}
+		cout << "\n";
+	}
+	cout << "Time elapsed (kernels and gather): " << ns_int.count() << " ns\n";
+	cout << "GFLOP/s of all devices: " << Gflops(nDim, kDim, mDim, (double)ns_int.count()) << "\n";
+
+	// Gathered C is only on host.
+	if (verifyOptions.trials > 0)
+	{
+		VerifyHost(shape, A, B, C, verifyOptions);
+	}
+
+	if (COMPUTE_HOST)
+	{
+		cl_float* hostC = new cl_float[(size_t)nDim * mDim];
+		SgemmParallel(nDim, mDim, kDim, A, B, hostC);
+
+		bool isEqual = true;
+		for (size_t i = 0; i < (size_t)nDim * mDim; i++)
+		{
+			if (abs(hostC[i] - C[i]) > 1e-3f * max(1.0f, abs(hostC[i])))
+			{
+				isEqual = false;
+				cout << "Different value on index: " << i << "\n";
+				cout << hostC[i] << " != " << C[i] << "\n";
+				break;
+			}
+		}
+		cout << "Equality: " << boolalpha << isEqual << "\n";
+		delete[] hostC;
+	}
+
+	delete[] A;
+	delete[] B;
+	delete[] C;
+}
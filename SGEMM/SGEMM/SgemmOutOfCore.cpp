@@ -0,0 +1,255 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "Sgemm.h"
+#include "HostSgemm.h"
+
+using namespace std;
+
+// Device memory used by the panels: ring of A and B panels and two blocks of C
+// (one is computed while the other one is read back).
+static cl_ulong PanelBytes(const PanelSizes& panels)
+{
+	cl_ulong panelA = (cl_ulong)panels.rows * panels.depth;
+	cl_ulong panelB = (cl_ulong)panels.depth * panels.cols;
+	cl_ulong blockC = (cl_ulong)panels.rows * panels.cols;
+	return (OUT_OF_CORE_RING_SIZE * (panelA + panelB) + 2 * blockC) * sizeof(float);
+}
+
+bool FitsDevice(cl::Device& device, const SgemmShape& shape)
+{
+	cl_ulong sizeA = (cl_ulong)shape.nDim * shape.kDim * sizeof(float);
+	cl_ulong sizeB = (cl_ulong)shape.kDim * shape.mDim * sizeof(float);
+	cl_ulong sizeC = (cl_ulong)shape.nDim * shape.mDim * sizeof(float);
+	cl_ulong maxAllocSize = device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+
+	return max({ sizeA, sizeB, sizeC }) <= maxAllocSize && sizeA + sizeB + sizeC <= device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
+}
+
+PanelSizes ChoosePanels(const SgemmShape& shape, const cl_ulong memoryLimit, const cl_ulong maxAllocSize, const cl_uint tileSize)
+{
+	PanelSizes panels{ shape.nDim, shape.mDim, shape.kDim };
+	auto fits = [&]()
+	{
+		cl_ulong largest = max({ (cl_ulong)panels.rows * panels.depth, (cl_ulong)panels.depth * panels.cols,
+			(cl_ulong)panels.rows * panels.cols }) * sizeof(float);
+		return PanelBytes(panels) <= memoryLimit && largest <= maxAllocSize;
+	};
+
+	// The biggest dimension is halved until everything fits, panels stay multiples of the tile size.
+	while (!fits())
+	{
+		cl_uint* biggest = &panels.rows;
+		if (panels.cols > *biggest)
+		{
+			biggest = &panels.cols;
+		}
+		if (panels.depth > *biggest)
+		{
+			biggest = &panels.depth;
+		}
+		if (*biggest <= tileSize)
+		{
+			throw runtime_error("Memory limit is too small for out-of-core SGEMM!");
+		}
+		*biggest = (cl_uint)RoundUp((*biggest + 1) / 2, tileSize);
+	}
+	return panels;
+}
+
+void MultiplyShapeOutOfCore(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const KernelConfig& tunedConfig, const SgemmShape& shape, cl_ulong memoryLimit,
+	const VerifyOptions& verifyOptions)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
+	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << " (out-of-core)\n";
+
+	if (memoryLimit == 0)
+	{
+		memoryLimit = device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>() / 2;
+	}
+	PanelSizes panels = ChoosePanels(shape, memoryLimit, device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>(), tunedConfig.tileSize);
+	cout << "Panels of A: " << panels.rows << " x " << panels.depth << ", panels of B: " << panels.depth << " x " << panels.cols
+		<< ", ring: " << OUT_OF_CORE_RING_SIZE << ", device memory: " << PanelBytes(panels) << " B\n";
+
+	cl_float* A = new cl_float[(size_t)nDim * kDim];
+	cl_float* B = new cl_float[(size_t)kDim * mDim];
+	cl_float* C = new cl_float[(size_t)nDim * mDim];
+
+	FillOrdered(A, nDim, kDim, 0.00001f, 0.00001f);
+	FillOrdered(B, kDim, mDim, 0.00002f, 0.00002f);
+
+	// Uploads and read backs run on the second queue, so they overlap kernels on commandQueue.
+	// Queues are synchronized only with events.
+	cl::CommandQueue transferQueue(context, device, CL_QUEUE_PROFILING_ENABLE);
+
+	struct RingSlot
+	{
+		cl::Buffer bufferA;
+		cl::Buffer bufferB;
+		// The last kernel which used the slot, panels can be overwritten after it.
+		cl::Event kernelDone;
+	};
+	vector<RingSlot> ring(OUT_OF_CORE_RING_SIZE);
+	for (RingSlot& slot : ring)
+	{
+		slot.bufferA = cl::Buffer(context, CL_MEM_READ_ONLY, (size_t)panels.rows * panels.depth * sizeof(float));
+		slot.bufferB = cl::Buffer(context, CL_MEM_READ_ONLY, (size_t)panels.depth * panels.cols * sizeof(float));
+	}
+	cl::Buffer bufferC[2];
+	cl::Event readDone[2];
+	for (cl::Buffer& buffer : bufferC)
+	{
+		buffer = cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)panels.rows * panels.cols * sizeof(float));
+	}
+
+	KernelConfig config = tunedConfig;
+	config.transA = false;
+	config.transB = false;
+	cl::Kernel kernel(programCache.Get(device, "Sgemm_general", shape, config), "Sgemm_general");
+
+	vector<cl::Event> transferEvents;
+	vector<cl::Event> kernelEvents;
+
+	// Block of C with all kernels enqueued, it's read back after uploads of the next block are queued
+	// so the in-order transfer queue doesn't wait for the last kernel before them.
+	struct PendingRead
+	{
+		bool valid;
+		int slot;
+		cl_uint row;
+		cl_uint col;
+		cl_uint rows;
+		cl_uint cols;
+		cl::Event lastKernel;
+	} pending{ false, 0, 0, 0, 0, 0, cl::Event() };
+
+	auto readBack = [&]()
+	{
+		vector<cl::Event> waitFor{ pending.lastKernel };
+		transferQueue.enqueueReadBufferRect(bufferC[pending.slot], false,
+			{ 0, 0, 0 }, { pending.col * sizeof(float), pending.row, 0 }, { pending.cols * sizeof(float), pending.rows, 1 },
+			panels.cols * sizeof(float), 0, mDim * sizeof(float), 0, C, &waitFor, &readDone[pending.slot]);
+		transferQueue.flush();
+		transferEvents.push_back(readDone[pending.slot]);
+		pending.valid = false;
+	};
+
+	auto tStart = chrono::high_resolution_clock::now();
+	size_t step = 0;
+	size_t block = 0;
+	for (cl_uint row = 0; row < nDim; row += panels.rows)
+	{
+		for (cl_uint col = 0; col < mDim; col += panels.cols, block++)
+		{
+			cl_uint rows = min(panels.rows, nDim - row);
+			cl_uint cols = min(panels.cols, mDim - col);
+			int slotC = block % 2;
+
+			for (cl_uint depthStart = 0; depthStart < kDim; depthStart += panels.depth, step++)
+			{
+				cl_uint depth = min(panels.depth, kDim - depthStart);
+				RingSlot& slot = ring[step % OUT_OF_CORE_RING_SIZE];
+
+				vector<cl::Event> uploadWait;
+				if (slot.kernelDone() != NULL)
+				{
+					uploadWait.push_back(slot.kernelDone);
+				}
+				cl::Event uploadA, uploadB;
+				transferQueue.enqueueWriteBufferRect(slot.bufferA, false,
+					{ 0, 0, 0 }, { depthStart * sizeof(float), row, 0 }, { depth * sizeof(float), rows, 1 },
+					panels.depth * sizeof(float), 0, kDim * sizeof(float), 0, A, &uploadWait, &uploadA);
+				transferQueue.enqueueWriteBufferRect(slot.bufferB, false,
+					{ 0, 0, 0 }, { col * sizeof(float), depthStart, 0 }, { cols * sizeof(float), depth, 1 },
+					panels.cols * sizeof(float), 0, mDim * sizeof(float), 0, B, &uploadWait, &uploadB);
+				transferQueue.flush();
+				transferEvents.push_back(uploadA);
+				transferEvents.push_back(uploadB);
+
+				if (pending.valid)
+				{
+					readBack();
+				}
+
+				// The first panel of K overwrites C (beta 0), the next ones are accumulated (beta 1).
+				// Buffer of C is free when the block computed in it two blocks ago has been read back.
+				vector<cl::Event> kernelWait{ uploadA, uploadB };
+				if (depthStart == 0 && readDone[slotC]() != NULL)
+				{
+					kernelWait.push_back(readDone[slotC]);
+				}
+				EnqueueSgemmGeneral(commandQueue, kernel, rows, depth, cols, 1.0f, slot.bufferA, 0, panels.depth,
+					slot.bufferB, 0, panels.cols, depthStart == 0 ? 0.0f : 1.0f, bufferC[slotC], 0, panels.cols,
+					config, &kernelWait, &slot.kernelDone);
+				commandQueue.flush();
+				kernelEvents.push_back(slot.kernelDone);
+			}
+
+			pending.valid = true;
+			pending.slot = slotC;
+			pending.row = row;
+			pending.col = col;
+			pending.rows = rows;
+			pending.cols = cols;
+			pending.lastKernel = kernelEvents.back();
+		}
+	}
+	readBack();
+	transferQueue.finish();
+	commandQueue.finish();
+	auto tEnd = chrono::high_resolution_clock::now();
+	auto ns_int = chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart);
+
+	cl_ulong transferTime = 0;
+	for (cl::Event& clEvent : transferEvents)
+	{
+		transferTime += Profile(clEvent, false);
+	}
+	cl_ulong kernelTime = 0;
+	for (cl::Event& clEvent : kernelEvents)
+	{
+		kernelTime += Profile(clEvent, false);
+	}
+	cout << "Blocks of C: " << block << ", kernels: " << kernelEvents.size() << "\n";
+	cout << "Transfers time: " << transferTime << " ns\n";
+	cout << "Kernels time: " << kernelTime << " ns\n";
+	cout << "Time elapsed: " << ns_int.count() << " ns (overlapped: "
+		<< (long long)(transferTime + kernelTime) - (long long)ns_int.count() << " ns)\n";
+	cout << "GFLOP/s with transfers: " << Gflops(nDim, kDim, mDim, (double)ns_int.count()) << "\n";
+
+	// Matrices don't fit into the device, so they are verified on host.
+	if (verifyOptions.trials > 0)
+	{
+		VerifyHost(shape, A, B, C, verifyOptions);
+	}
+
+	if (COMPUTE_HOST)
+	{
+		cl_float* hostC = new cl_float[(size_t)nDim * mDim];
+		SgemmParallel(nDim, mDim, kDim, A, B, hostC);
+
+		bool isEqual = true;
+		for (size_t i = 0; i < (size_t)nDim * mDim; i++)
+		{
+			if (abs(hostC[i] - C[i]) > 1e-3f * max(1.0f, abs(hostC[i])))
+			{
+				isEqual = false;
+				cout << "Different value on index: " << i << "\n";
+				cout << hostC[i] << " != " << C[i] << "\n";
+				break;
+			}
+		}
+		cout << "Equality: " << boolalpha << isEqual << "\n";
+		delete[] hostC;
+	}
+
+	delete[] A;
+	delete[] B;
+	delete[] C;
+}
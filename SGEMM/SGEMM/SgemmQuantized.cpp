@@ -0,0 +1,204 @@
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "Sgemm.h"
+
+using namespace std;
+
+void QuantizeRows(const float* M, const cl_uint rows, const cl_uint cols, const bool transpose,
+	cl_char* Q, cl_float* scale, cl_int* zero)
+{
+	for (cl_uint row = 0; row < rows; row++)
+	{
+		// Range always contains 0, so zero is exactly representable.
+		float low = 0.0f, high = 0.0f;
+		for (cl_uint col = 0; col < cols; col++)
+		{
+			float value = transpose ? M[(size_t)col * rows + row] : M[(size_t)row * cols + col];
+			low = min(low, value);
+			high = max(high, value);
+		}
+		scale[row] = high > low ? (high - low) / 255.0f : 1.0f;
+		zero[row] = (cl_int)min(127.0f, max(-128.0f, nearbyintf(-128.0f - low / scale[row])));
+
+		for (cl_uint col = 0; col < cols; col++)
+		{
+			float value = transpose ? M[(size_t)col * rows + row] : M[(size_t)row * cols + col];
+			Q[(size_t)row * cols + col] = (cl_char)min(127.0f, max(-128.0f, nearbyintf(value / scale[row]) + zero[row]));
+		}
+	}
+}
+
+void GemmInt8Host(const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const cl_char* A, const cl_char* BT,
+	const cl_float* scaleA, const cl_int* zeroA, const cl_float* scaleB, const cl_int* zeroB, cl_float* C)
+{
+	for (cl_uint i = 0; i < nDim; i++)
+	{
+		for (cl_uint j = 0; j < mDim; j++)
+		{
+			cl_int dot = 0;
+			for (cl_uint k = 0; k < kDim; k++)
+			{
+				dot += (A[(size_t)i * kDim + k] - zeroA[i]) * (BT[(size_t)j * kDim + k] - zeroB[j]);
+			}
+			C[(size_t)i * mDim + j] = scaleA[i] * scaleB[j] * (float)dot;
+		}
+	}
+}
+
+static void SetQuantizedArgs(cl::Kernel& kernel, const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferBT, cl::Buffer& scaleA, cl::Buffer& zeroA, cl::Buffer& scaleB, cl::Buffer& zeroB)
+{
+	if (kDim > QUANT_MAX_K)
+	{
+		throw runtime_error("K of quantized GEMM can't be larger than " + to_string(QUANT_MAX_K) + ", int32 dot products would overflow!");
+	}
+	kernel.setArg(0, sizeof(cl_uint), &nDim);
+	kernel.setArg(1, sizeof(cl_uint), &kDim);
+	kernel.setArg(2, sizeof(cl_uint), &mDim);
+	kernel.setArg(3, bufferA);
+	kernel.setArg(4, bufferBT);
+	kernel.setArg(5, scaleA);
+	kernel.setArg(6, zeroA);
+	kernel.setArg(7, scaleB);
+	kernel.setArg(8, zeroB);
+}
+
+static cl_ulong EnqueueQuantized(cl::CommandQueue& commandQueue, cl::Kernel& kernel, const cl_uint nDim, const cl_uint mDim, bool printInfo)
+{
+	// One work item per value of C, dimension 0 is the column.
+	cl::NDRange global = cl::NDRange(RoundUp(mDim, QUANT_TILE_SIZE), RoundUp(nDim, QUANT_TILE_SIZE));
+	cl::NDRange local = cl::NDRange(QUANT_TILE_SIZE, QUANT_TILE_SIZE);
+	cl::Event clEvent;
+
+	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, NULL, &clEvent);
+	clEvent.wait();
+
+	return Profile(clEvent, printInfo);
+}
+
+cl_ulong KernelGemmInt8Float(cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, cl::Buffer& bufferA, cl::Buffer& bufferBT,
+	cl::Buffer& scaleA, cl::Buffer& zeroA, cl::Buffer& scaleB, cl::Buffer& zeroB, cl::Buffer& bufferC, bool printInfo)
+{
+	cl::Kernel kernel(program, "Gemm_int8_float");
+	SetQuantizedArgs(kernel, nDim, kDim, mDim, bufferA, bufferBT, scaleA, zeroA, scaleB, zeroB);
+	kernel.setArg(9, bufferC);
+
+	return EnqueueQuantized(commandQueue, kernel, nDim, mDim, printInfo);
+}
+
+cl_ulong KernelGemmInt8(cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, cl::Buffer& bufferA, cl::Buffer& bufferBT,
+	cl::Buffer& scaleA, cl::Buffer& zeroA, cl::Buffer& scaleB, cl::Buffer& zeroB,
+	const cl_float scaleC, const cl_int zeroC, cl::Buffer& bufferC, bool printInfo)
+{
+	cl::Kernel kernel(program, "Gemm_int8");
+	SetQuantizedArgs(kernel, nDim, kDim, mDim, bufferA, bufferBT, scaleA, zeroA, scaleB, zeroB);
+	kernel.setArg(9, sizeof(cl_float), &scaleC);
+	kernel.setArg(10, sizeof(cl_int), &zeroC);
+	kernel.setArg(11, bufferC);
+
+	return EnqueueQuantized(commandQueue, kernel, nDim, mDim, printInfo);
+}
+
+void BenchmarkQuantized(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const SgemmShape& shape)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
+	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << " (int8)\n";
+
+	vector<cl_float> A((size_t)nDim * kDim);
+	vector<cl_float> B((size_t)kDim * mDim);
+	mt19937 generator(12345);
+	uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	generate(A.begin(), A.end(), [&]() { return distribution(generator); });
+	generate(B.begin(), B.end(), [&]() { return distribution(generator) * 0.5f + 0.25f; });
+
+	// A is quantized per row, B per column, so columns of B become rows of BT.
+	vector<cl_char> quantA(A.size()), quantBT(B.size());
+	vector<cl_float> scaleA(nDim), scaleB(mDim);
+	vector<cl_int> zeroA(nDim), zeroB(mDim);
+	QuantizeRows(A.data(), nDim, kDim, false, quantA.data(), scaleA.data(), zeroA.data());
+	QuantizeRows(B.data(), mDim, kDim, true, quantBT.data(), scaleB.data(), zeroB.data());
+
+	auto buffer = [&](size_t size, const void* data)
+	{
+		return cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, size, const_cast<void*>(data));
+	};
+	cl::Buffer bufferA = buffer(quantA.size(), quantA.data());
+	cl::Buffer bufferBT = buffer(quantBT.size(), quantBT.data());
+	cl::Buffer bufferScaleA = buffer(nDim * sizeof(cl_float), scaleA.data());
+	cl::Buffer bufferZeroA = buffer(nDim * sizeof(cl_int), zeroA.data());
+	cl::Buffer bufferScaleB = buffer(mDim * sizeof(cl_float), scaleB.data());
+	cl::Buffer bufferZeroB = buffer(mDim * sizeof(cl_int), zeroB.data());
+	cl::Buffer bufferC(context, CL_MEM_READ_WRITE, (size_t)nDim * mDim * sizeof(cl_float));
+	cl::Buffer bufferQuantC(context, CL_MEM_WRITE_ONLY, (size_t)nDim * mDim);
+
+	cl::Program& program = programCache.Get(device, "Gemm_int8", shape, KernelConfig(), false);
+	cl_ulong elapsed = KernelGemmInt8Float(program, commandQueue, nDim, kDim, mDim, bufferA, bufferBT,
+		bufferScaleA, bufferZeroA, bufferScaleB, bufferZeroB, bufferC, false);
+	vector<cl_float> C((size_t)nDim * mDim);
+	commandQueue.enqueueReadBuffer(bufferC, true, 0, C.size() * sizeof(cl_float), (void*)C.data());
+	cout << "Gemm_int8_float GOP/s: " << Gflops(nDim, kDim, mDim, (double)elapsed) << "\n";
+
+	// Output range of the float result, quantized symmetrically around 0.
+	float largest = 0.0f;
+	for (cl_float value : C)
+	{
+		largest = max(largest, fabs(value));
+	}
+	cl_float scaleC = largest > 0.0f ? largest / 127.0f : 1.0f;
+	elapsed = KernelGemmInt8(program, commandQueue, nDim, kDim, mDim, bufferA, bufferBT,
+		bufferScaleA, bufferZeroA, bufferScaleB, bufferZeroB, scaleC, 0, bufferQuantC, false);
+	cout << "Gemm_int8 GOP/s: " << Gflops(nDim, kDim, mDim, (double)elapsed) << "\n";
+
+	// The same multiplication in float for comparison of speed and quantization error.
+	cl::Buffer bufferFloatA = buffer(A.size() * sizeof(cl_float), A.data());
+	cl::Buffer bufferFloatB = buffer(B.size() * sizeof(cl_float), B.data());
+	KernelConfig config = tuningTable.Get("Sgemm_tiled");
+	elapsed = KernelSgemmTiled(device, programCache.Get(device, "Sgemm_tiled", shape, config, false), commandQueue,
+		nDim, kDim, mDim, bufferFloatA, bufferFloatB, bufferC, config, false);
+	vector<cl_float> floatC((size_t)nDim * mDim);
+	commandQueue.enqueueReadBuffer(bufferC, true, 0, floatC.size() * sizeof(cl_float), (void*)floatC.data());
+	cout << "Sgemm_tiled GFLOP/s: " << Gflops(nDim, kDim, mDim, (double)elapsed) << "\n";
+
+	double sumSquares = 0.0, sumExpected = 0.0;
+	for (size_t i = 0; i < C.size(); i++)
+	{
+		sumSquares += ((double)C[i] - floatC[i]) * ((double)C[i] - floatC[i]);
+		sumExpected += (double)floatC[i] * floatC[i];
+	}
+	cout << "Quantization RMS relative error against float: " << sqrt(sumSquares / sumExpected) << "\n";
+
+	if (COMPUTE_HOST)
+	{
+		// Integer products are exact, so the device and host results are the same.
+		vector<cl_float> hostC((size_t)nDim * mDim);
+		GemmInt8Host(nDim, kDim, mDim, quantA.data(), quantBT.data(), scaleA.data(), zeroA.data(), scaleB.data(), zeroB.data(), hostC.data());
+		cout << "Equality: " << boolalpha << (hostC == C) << "\n";
+
+		// Division on device isn't correctly rounded by default, so requantized values can differ by 1.
+		vector<cl_char> quantC(C.size());
+		commandQueue.enqueueReadBuffer(bufferQuantC, true, 0, quantC.size(), (void*)quantC.data());
+		bool isEqual = true;
+		for (size_t i = 0; i < quantC.size(); i++)
+		{
+			float expected = min(127.0f, max(-128.0f, nearbyintf(hostC[i] / scaleC)));
+			if (fabs(expected - quantC[i]) > 1.0f)
+			{
+				isEqual = false;
+				cout << "Different value on index: " << i << "\n";
+				cout << expected << " != " << (int)quantC[i] << "\n";
+				break;
+			}
+		}
+		cout << "Equality of int8 output: " << boolalpha << isEqual << "\n";
+	}
+}
@@ -0,0 +1,142 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "Sgemm.h"
+
+using namespace std;
+
+cl_ulong KernelTranspose(cl::Program& program, cl::CommandQueue& commandQueue, const cl_uint rows, const cl_uint cols,
+	cl::Buffer& bufferM, cl::Buffer& bufferMT, bool printInfo)
+{
+	cl::Kernel kernel(program, "Transpose");
+
+	kernel.setArg(0, sizeof(cl_uint), &rows);
+	kernel.setArg(1, sizeof(cl_uint), &cols);
+	kernel.setArg(2, bufferM);
+	kernel.setArg(3, bufferMT);
+
+	// Dimension 0 is the column of M, so work items of a group read neighbouring addresses.
+	cl::NDRange global = cl::NDRange(RoundUp(cols, TRANSPOSE_TILE_SIZE), RoundUp(rows, TRANSPOSE_TILE_SIZE));
+	cl::NDRange local = cl::NDRange(TRANSPOSE_TILE_SIZE, TRANSPOSE_TILE_SIZE);
+	cl::Event clEvent;
+
+	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, NULL, &clEvent);
+	clEvent.wait();
+
+	return Profile(clEvent, printInfo);
+}
+
+RepackCache::RepackCache(cl::Context& context, ProgramCache& programCache)
+	: context(context), programCache(programCache)
+{
+}
+
+cl::Buffer& RepackCache::Transposed(cl::Device& device, cl::CommandQueue& commandQueue, cl::Buffer& bufferB,
+	const cl_uint kDim, const cl_uint mDim, cl_ulong* elapsed)
+{
+	auto found = entries.find(bufferB());
+	if (found != entries.end() && found->second.kDim == kDim && found->second.mDim == mDim)
+	{
+		if (elapsed)
+		{
+			*elapsed = 0;
+		}
+		return found->second.transposed;
+	}
+
+	Entry entry{ bufferB, kDim, mDim, cl::Buffer(context, CL_MEM_READ_WRITE, (size_t)kDim * mDim * sizeof(float)) };
+	// Transpose doesn't depend on the shape, one program serves every B.
+	cl::Program& program = programCache.Get(device, "Transpose", SgemmShape{ 0, 0, 0 }, KernelConfig(), false);
+	cl_ulong transposeTime = KernelTranspose(program, commandQueue, kDim, mDim, bufferB, entry.transposed, false);
+	if (elapsed)
+	{
+		*elapsed = transposeTime;
+	}
+
+	Entry& cached = entries[bufferB()];
+	cached = entry;
+	return cached.transposed;
+}
+
+void RepackCache::Invalidate(cl::Buffer& bufferB)
+{
+	entries.erase(bufferB());
+}
+
+static bool EqualResults(const vector<cl_float>& expected, const vector<cl_float>& C)
+{
+	return memcmp(expected.data(), C.data(), C.size() * sizeof(cl_float)) == 0;
+}
+
+void MultiplyShapeRepacked(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const SgemmShape& shape)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
+	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << " (repacked B)\n";
+
+	vector<cl_float> A((size_t)nDim * kDim);
+	vector<cl_float> B((size_t)kDim * mDim);
+	vector<cl_float> C((size_t)nDim * mDim);
+	vector<cl_float> repackedC((size_t)nDim * mDim);
+	FillOrdered(A.data(), nDim, kDim, 0.00001f, 0.00001f);
+	FillOrdered(B.data(), kDim, mDim, 0.00002f, 0.00002f);
+
+	size_t sizeA = A.size() * sizeof(float);
+	size_t sizeB = B.size() * sizeof(float);
+	size_t sizeC = C.size() * sizeof(float);
+	cl::Buffer bufferA(context, CL_MEM_READ_ONLY, sizeA);
+	cl::Buffer bufferB(context, CL_MEM_READ_ONLY, sizeB);
+	cl::Buffer bufferC(context, CL_MEM_WRITE_ONLY, sizeC);
+	commandQueue.enqueueWriteBuffer(bufferA, true, 0, sizeA, (void*)A.data());
+	commandQueue.enqueueWriteBuffer(bufferB, true, 0, sizeB, (void*)B.data());
+
+	RepackCache repackCache(context, programCache);
+	cl_ulong repackTime = 0;
+	repackCache.Transposed(device, commandQueue, bufferB, kDim, mDim, &repackTime);
+	cout << "Transpose of B: " << repackTime << " ns\n";
+
+	// Sgemm_local keeps a row of A in private memory, so it can fail to build or run for big K.
+	try
+	{
+		KernelConfig config = tuningTable.Get("Sgemm_local");
+		cl_ulong columns = KernelSgemmLocal(device, programCache.Get(device, "Sgemm_local", shape, config, false), commandQueue,
+			nDim, kDim, mDim, bufferA, bufferB, bufferC, config, false);
+		commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)C.data());
+
+		// Second multiplication with the same B takes the transposed copy from the cache.
+		cl::Buffer& bufferBT = repackCache.Transposed(device, commandQueue, bufferB, kDim, mDim);
+		cl_ulong rows = KernelSgemmLocalTransposed(device, programCache.Get(device, "Sgemm_local_transposed", shape, config, false), commandQueue,
+			nDim, kDim, mDim, bufferA, bufferBT, bufferC, config, false);
+		commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)repackedC.data());
+
+		cout << "Sgemm_local: " << columns << " ns, Sgemm_local_transposed: " << rows << " ns\n";
+		cout << "Equality: " << boolalpha << EqualResults(C, repackedC) << "\n";
+	}
+	catch (cl::Error& e)
+	{
+		cout << "Sgemm_local skipped (" << e.err() << "): " << e.what() << "\n";
+	}
+
+	KernelConfig config = tuningTable.Get("Sgemm_tiled");
+	config.transB = false;
+	cl_ulong general = KernelSgemmGeneral(device, programCache.Get(device, "Sgemm_general", shape, config, false), commandQueue,
+		nDim, kDim, mDim, 1.0f, bufferA, 0, kDim, bufferB, 0, mDim, 0.0f, bufferC, 0, mDim, config, false);
+	commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)C.data());
+
+	config.transB = true;
+	cl::Buffer& bufferBT = repackCache.Transposed(device, commandQueue, bufferB, kDim, mDim);
+	cl_ulong generalTransposed = KernelSgemmGeneral(device, programCache.Get(device, "Sgemm_general", shape, config, false), commandQueue,
+		nDim, kDim, mDim, 1.0f, bufferA, 0, kDim, bufferBT, 0, kDim, 0.0f, bufferC, 0, mDim, config, false);
+	commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)repackedC.data());
+
+	cout << "Sgemm_general: " << general << " ns, Sgemm_general on transposed B: " << generalTransposed << " ns\n";
+	cout << "Equality: " << boolalpha << EqualResults(C, repackedC) << "\n";
+	if (generalTransposed < general)
+	{
+		cout << "Transpose pays off after " << repackTime / (general - generalTransposed) + 1 << " multiplications with the same B\n";
+	}
+}
@@ -0,0 +1,170 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "Sgemm.h"
+#include "HostSgemm.h"
+
+using namespace std;
+
+SgemmSession::SgemmSession(cl::Context& context, cl::Device& device, ProgramCache& programCache,
+	const KernelConfig& tunedConfig, const float* B, const cl_uint kDim, const cl_uint mDim, const cl_uint maxRows)
+	: context(context), device(device), kDim(kDim), mDim(mDim), maxRows(maxRows), config(tunedConfig), next(0)
+{
+	commandQueue = cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE);
+	uploadQueue = cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE);
+	readQueue = cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE);
+
+	// B is uploaded and transposed once, Sgemm_general reads it as op(B) = T for every batch.
+	size_t sizeB = (size_t)kDim * mDim * sizeof(float);
+	cl::Buffer bufferB(context, CL_MEM_READ_ONLY, sizeB);
+	bufferBT = cl::Buffer(context, CL_MEM_READ_ONLY, sizeB);
+	cl::Event uploadB;
+	commandQueue.enqueueWriteBuffer(bufferB, true, 0, sizeB, (void*)B, NULL, &uploadB);
+	setupTime = Profile(uploadB, false);
+	setupTime += KernelTranspose(programCache.Get(device, "Transpose", SgemmShape{ 0, 0, 0 }, KernelConfig(), false),
+		commandQueue, kDim, mDim, bufferB, bufferBT, false);
+
+	config.transA = false;
+	config.transB = true;
+	kernel = cl::Kernel(programCache.Get(device, "Sgemm_general", SgemmShape{ maxRows, kDim, mDim }, config, false), "Sgemm_general");
+
+	for (Slot& slot : slots)
+	{
+		slot.bufferA = cl::Buffer(context, CL_MEM_READ_ONLY, (size_t)maxRows * kDim * sizeof(float));
+		slot.bufferC = cl::Buffer(context, CL_MEM_WRITE_ONLY, (size_t)maxRows * mDim * sizeof(float));
+	}
+}
+
+SgemmSession::~SgemmSession()
+{
+	// Destructor can't throw, Finish() reports errors when it is called explicitly.
+	try
+	{
+		Finish();
+	}
+	catch (cl::Error& e)
+	{
+		cout << "SgemmSession: pending batches failed (" << e.err() << "): " << e.what() << "\n";
+	}
+}
+
+cl::Event SgemmSession::Submit(const float* A, const cl_uint rows, float* C, cl::Event* upload)
+{
+	if (rows == 0 || rows > maxRows)
+	{
+		throw runtime_error("Batch of A must have 1 to maxRows rows!");
+	}
+
+	Slot& slot = slots[next];
+	next = (next + 1) % SESSION_SLOTS;
+
+	// A of the slot can be overwritten after the previous kernel which read it.
+	vector<cl::Event> uploadWait;
+	if (slot.kernelDone() != NULL)
+	{
+		uploadWait.push_back(slot.kernelDone);
+	}
+	cl::Event uploadA;
+	uploadQueue.enqueueWriteBuffer(slot.bufferA, false, 0, (size_t)rows * kDim * sizeof(float), (void*)A, &uploadWait, &uploadA);
+	uploadQueue.flush();
+
+	// C of the slot can be overwritten after the previous batch has been read back.
+	vector<cl::Event> kernelWait{ uploadA };
+	if (slot.readDone() != NULL)
+	{
+		kernelWait.push_back(slot.readDone);
+	}
+	EnqueueSgemmGeneral(commandQueue, kernel, rows, kDim, mDim, 1.0f, slot.bufferA, 0, kDim,
+		bufferBT, 0, kDim, 0.0f, slot.bufferC, 0, mDim, config, &kernelWait, &slot.kernelDone);
+	commandQueue.flush();
+
+	vector<cl::Event> readWait{ slot.kernelDone };
+	readQueue.enqueueReadBuffer(slot.bufferC, false, 0, (size_t)rows * mDim * sizeof(float), (void*)C, &readWait, &slot.readDone);
+	readQueue.flush();
+
+	if (upload)
+	{
+		*upload = uploadA;
+	}
+	return slot.readDone;
+}
+
+void SgemmSession::Finish()
+{
+	uploadQueue.finish();
+	commandQueue.finish();
+	readQueue.finish();
+}
+
+void RunSession(cl::Context& context, cl::Device& device, ProgramCache& programCache, const KernelConfig& tunedConfig,
+	const SgemmShape& shape, const cl_uint batchCount, const VerifyOptions& verifyOptions)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
+	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << " (session, " << batchCount << " batches of A)\n";
+
+	vector<cl_float> B((size_t)kDim * mDim);
+	FillOrdered(B.data(), kDim, mDim, 0.00002f, 0.00002f);
+
+	auto tSetup = chrono::high_resolution_clock::now();
+	SgemmSession session(context, device, programCache, tunedConfig, B.data(), kDim, mDim, nDim);
+	auto tStart = chrono::high_resolution_clock::now();
+	cout << "Session setup (build, upload and transpose of B): "
+		<< chrono::duration_cast<chrono::nanoseconds>(tStart - tSetup).count() << " ns, device time: " << session.SetupTime() << " ns\n";
+
+	// Every batch has its own A and C, they must stay valid until the read back of C has finished.
+	vector<vector<cl_float>> A(batchCount, vector<cl_float>((size_t)nDim * kDim));
+	vector<vector<cl_float>> C(batchCount, vector<cl_float>((size_t)nDim * mDim));
+	vector<cl::Event> uploaded(batchCount);
+	vector<cl::Event> done(batchCount);
+	for (cl_uint batch = 0; batch < batchCount; batch++)
+	{
+		FillOrdered(A[batch].data(), nDim, kDim, 0.00001f * (batch + 1), 0.00001f);
+		done[batch] = session.Submit(A[batch].data(), nDim, C[batch].data(), &uploaded[batch]);
+	}
+	cl::Event::waitForEvents(done);
+	auto tEnd = chrono::high_resolution_clock::now();
+	auto ns_int = chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart);
+
+	// Latency of one request is from the start of its upload of A to the end of its read back of C.
+	vector<cl_ulong> latencies;
+	for (cl_uint batch = 0; batch < batchCount; batch++)
+	{
+		latencies.push_back(done[batch].getProfilingInfo<CL_PROFILING_COMMAND_END>()
+			- uploaded[batch].getProfilingInfo<CL_PROFILING_COMMAND_START>());
+	}
+	sort(latencies.begin(), latencies.end());
+	cout << "Latency per batch: median " << latencies[latencies.size() / 2] << " ns, max " << latencies.back()
+		<< " ns (without session every request also pays " << session.SetupTime() << " ns for B)\n";
+	cout << "Time elapsed: " << ns_int.count() << " ns, per batch: " << ns_int.count() / batchCount << " ns\n";
+	cout << "GFLOP/s of all batches: " << Gflops(nDim * batchCount, kDim, mDim, (double)ns_int.count()) << "\n";
+
+	if (verifyOptions.trials > 0)
+	{
+		VerifyHost(shape, A.back().data(), B.data(), C.back().data(), verifyOptions);
+	}
+
+	if (COMPUTE_HOST)
+	{
+		cl_float* hostC = new cl_float[(size_t)nDim * mDim];
+		SgemmParallel(nDim, mDim, kDim, A.back().data(), B.data(), hostC);
+
+		bool isEqual = true;
+		for (size_t i = 0; i < (size_t)nDim * mDim; i++)
+		{
+			if (abs(hostC[i] - C.back()[i]) > 1e-3f * max(1.0f, abs(hostC[i])))
+			{
+				isEqual = false;
+				cout << "Different value on index: " << i << "\n";
+				cout << hostC[i] << " != " << C.back()[i] << "\n";
+				break;
+			}
+		}
+		cout << "Equality: " << boolalpha << isEqual << "\n";
+		delete[] hostC;
+	}
+}
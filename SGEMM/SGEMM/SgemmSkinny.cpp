@@ -0,0 +1,109 @@
+#include <iostream>
+#include "Sgemm.h"
+
+using namespace std;
+
+static void SetSkinnyArgs(cl::Device& device, cl::Kernel& kernel, const size_t localSize,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC)
+{
+	if (kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) < localSize)
+	{
+		throw runtime_error("Skinny kernels need work groups of SKINNY_LOCAL_SIZE or WIDE_COLUMNS * WIDE_SPLIT_K work items!");
+	}
+
+	kernel.setArg(0, sizeof(cl_uint), &nDim);
+	kernel.setArg(1, sizeof(cl_uint), &kDim);
+	kernel.setArg(2, sizeof(cl_uint), &mDim);
+	kernel.setArg(3, bufferA);
+	kernel.setArg(4, bufferB);
+	kernel.setArg(5, bufferC);
+}
+
+cl_ulong KernelSgemmTall(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, bool printInfo)
+{
+	if (mDim > SKINNY_MAX_DIM)
+	{
+		throw runtime_error("Sgemm_tall needs M up to SKINNY_MAX_DIM!");
+	}
+
+	cl::Kernel kernel(program, "Sgemm_tall");
+	SetSkinnyArgs(device, kernel, SKINNY_LOCAL_SIZE, nDim, kDim, mDim, bufferA, bufferB, bufferC);
+
+	// One work group per row of C.
+	cl::NDRange global = cl::NDRange((size_t)nDim * SKINNY_LOCAL_SIZE);
+	cl::NDRange local = cl::NDRange(SKINNY_LOCAL_SIZE);
+	cl::Event clEvent;
+
+	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, NULL, &clEvent);
+	clEvent.wait();
+
+	return Profile(clEvent, printInfo);
+}
+
+cl_ulong KernelSgemmWide(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, bool printInfo)
+{
+	if (nDim > SKINNY_MAX_DIM)
+	{
+		throw runtime_error("Sgemm_wide needs N up to SKINNY_MAX_DIM!");
+	}
+
+	cl::Kernel kernel(program, "Sgemm_wide");
+	SetSkinnyArgs(device, kernel, WIDE_COLUMNS * WIDE_SPLIT_K, nDim, kDim, mDim, bufferA, bufferB, bufferC);
+
+	// Dimension 0 is the column of C, dimension 1 the slice of K (one work group in it).
+	cl::NDRange global = cl::NDRange(RoundUp(mDim, WIDE_COLUMNS), WIDE_SPLIT_K);
+	cl::NDRange local = cl::NDRange(WIDE_COLUMNS, WIDE_SPLIT_K);
+	cl::Event clEvent;
+
+	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, NULL, &clEvent);
+	clEvent.wait();
+
+	return Profile(clEvent, printInfo);
+}
+
+cl_ulong KernelSgemv(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, cl::Buffer& bufferA, cl::Buffer& bufferX, cl::Buffer& bufferY, bool printInfo)
+{
+	return KernelSgemmTall(device, program, commandQueue, nDim, kDim, 1, bufferA, bufferX, bufferY, printInfo);
+}
+
+// Tiles of Sgemm_tiled would be almost empty in one dimension, so narrow C is reduced over K instead.
+// Tall shapes win when both dimensions are narrow, their work groups are smaller.
+string SgemmKernelName(const SgemmShape& shape)
+{
+	if (shape.mDim <= SKINNY_MAX_DIM)
+	{
+		return "Sgemm_tall";
+	}
+	if (shape.nDim <= SKINNY_MAX_DIM)
+	{
+		return "Sgemm_wide";
+	}
+	return "Sgemm_tiled";
+}
+
+cl_ulong KernelSgemm(cl::Device& device, ProgramCache& programCache, cl::CommandQueue& commandQueue, const TuningTable& tuningTable,
+	const SgemmShape& shape, cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, bool printInfo)
+{
+	string kernelName = SgemmKernelName(shape);
+	KernelConfig config = tuningTable.Get(kernelName);
+	cl::Program& program = programCache.Get(device, kernelName, shape, config, printInfo);
+	if (printInfo)
+	{
+		cout << "Kernel: " << kernelName << "\n";
+	}
+
+	if (kernelName == "Sgemm_tall")
+	{
+		return KernelSgemmTall(device, program, commandQueue, shape.nDim, shape.kDim, shape.mDim, bufferA, bufferB, bufferC, printInfo);
+	}
+	if (kernelName == "Sgemm_wide")
+	{
+		return KernelSgemmWide(device, program, commandQueue, shape.nDim, shape.kDim, shape.mDim, bufferA, bufferB, bufferC, printInfo);
+	}
+	return KernelSgemmTiled(device, program, commandQueue, shape.nDim, shape.kDim, shape.mDim, bufferA, bufferB, bufferC, config, printInfo);
+}
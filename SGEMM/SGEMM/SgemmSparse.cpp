@@ -0,0 +1,235 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "Sgemm.h"
+#include "HostSgemm.h"
+
+using namespace std;
+
+CsrMatrix DenseToCsr(const float* M, const cl_uint rows, const cl_uint cols)
+{
+	CsrMatrix csr{ rows, cols, {}, {}, {}, {} };
+	csr.rowOffsets.reserve(rows + 1);
+	csr.rowOffsets.push_back(0);
+	for (cl_uint row = 0; row < rows; row++)
+	{
+		for (cl_uint col = 0; col < cols; col++)
+		{
+			float value = M[(size_t)row * cols + col];
+			if (value != 0.0f)
+			{
+				csr.columns.push_back(col);
+				csr.values.push_back(value);
+			}
+		}
+		csr.rowOffsets.push_back((cl_uint)csr.values.size());
+	}
+
+	csr.rowOrder.resize(rows);
+	for (cl_uint row = 0; row < rows; row++)
+	{
+		csr.rowOrder[row] = row;
+	}
+	auto length = [&](cl_uint row) { return csr.rowOffsets[row + 1] - csr.rowOffsets[row]; };
+	stable_sort(csr.rowOrder.begin(), csr.rowOrder.end(), [&](cl_uint a, cl_uint b) { return length(a) > length(b); });
+	return csr;
+}
+
+double Density(const float* M, const size_t count)
+{
+	return (double)(count - std::count(M, M + count, 0.0f)) / count;
+}
+
+DeviceCsr UploadCsr(cl::Context& context, const CsrMatrix& csr)
+{
+	// Buffers can't be empty, A without non-zero values gets one unused value.
+	size_t nonZeros = max<size_t>(csr.values.size(), 1);
+	auto buffer = [&](size_t size, const void* data)
+	{
+		return cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, size, const_cast<void*>(data));
+	};
+	vector<cl_uint> columns(csr.columns);
+	vector<cl_float> values(csr.values);
+	columns.resize(nonZeros);
+	values.resize(nonZeros);
+
+	return DeviceCsr{ csr.rows, csr.cols,
+		buffer(csr.rowOffsets.size() * sizeof(cl_uint), csr.rowOffsets.data()),
+		buffer(nonZeros * sizeof(cl_uint), columns.data()),
+		buffer(nonZeros * sizeof(cl_float), values.data()),
+		buffer(csr.rowOrder.size() * sizeof(cl_uint), csr.rowOrder.data()) };
+}
+
+cl_ulong KernelSpmmCsr(cl::Context& context, cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const DeviceCsr& A, const cl_uint mDim, cl::Buffer& bufferB, cl::Buffer& bufferC, bool printInfo)
+{
+	cl::Kernel kernel(program, "Spmm_csr");
+
+	if (kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) < SPARSE_LOCAL_SIZE)
+	{
+		throw runtime_error("Spmm_csr needs work groups of SPARSE_LOCAL_SIZE work items!");
+	}
+
+	cl_uint nextRow = 0;
+	cl::Buffer bufferNextRow(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_uint), &nextRow);
+
+	kernel.setArg(0, sizeof(cl_uint), &A.rows);
+	kernel.setArg(1, sizeof(cl_uint), &mDim);
+	kernel.setArg(2, A.rowOffsets);
+	kernel.setArg(3, A.columns);
+	kernel.setArg(4, A.values);
+	kernel.setArg(5, A.rowOrder);
+	kernel.setArg(6, bufferNextRow);
+	kernel.setArg(7, bufferB);
+	kernel.setArg(8, bufferC);
+
+	// Work groups stay resident and take rows until all are done, more of them than fit on the device would only wait.
+	size_t groups = min<size_t>(A.rows, device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() * SPARSE_GROUPS_PER_COMPUTE_UNIT);
+	cl::NDRange global = cl::NDRange(max<size_t>(groups, 1) * SPARSE_LOCAL_SIZE);
+	cl::NDRange local = cl::NDRange(SPARSE_LOCAL_SIZE);
+	cl::Event clEvent;
+
+	if (printInfo)
+	{
+		cout << "Work groups: " << groups << "\n";
+	}
+
+	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, NULL, &clEvent);
+	clEvent.wait();
+
+	return Profile(clEvent, printInfo);
+}
+
+cl_ulong MultiplyDispatched(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const SgemmShape& shape,
+	const float* A, cl::Buffer& bufferB, cl::Buffer& bufferC, bool* isSparse)
+{
+	bool sparse = Density(A, (size_t)shape.nDim * shape.kDim) <= SPARSE_MAX_DENSITY;
+	if (isSparse)
+	{
+		*isSparse = sparse;
+	}
+
+	if (sparse)
+	{
+		DeviceCsr csr = UploadCsr(context, DenseToCsr(A, shape.nDim, shape.kDim));
+		return KernelSpmmCsr(context, device, programCache.Get(device, "Spmm_csr", SgemmShape{ 0, 0, 0 }, KernelConfig(), false),
+			commandQueue, csr, shape.mDim, bufferB, bufferC, false);
+	}
+
+	cl::Buffer bufferA(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, (size_t)shape.nDim * shape.kDim * sizeof(float), const_cast<float*>(A));
+	KernelConfig config = tuningTable.Get("Sgemm_tiled");
+	return KernelSgemmTiled(device, programCache.Get(device, "Sgemm_tiled", shape, config, false), commandQueue,
+		shape.nDim, shape.kDim, shape.mDim, bufferA, bufferB, bufferC, config, false);
+}
+
+// Every 16th row is 8 times denser than the others, so work groups get very different amounts of work.
+static void FillSparse(vector<cl_float>& A, const cl_uint nDim, const cl_uint kDim, const double density, mt19937& generator)
+{
+	uniform_real_distribution<float> values(-1.0f, 1.0f);
+	uniform_real_distribution<double> probability(0.0, 1.0);
+	double base = density * 16.0 / 23.0;
+	for (cl_uint row = 0; row < nDim; row++)
+	{
+		double rowDensity = (row % 16 == 0) ? min(1.0, 8.0 * base) : base;
+		for (cl_uint col = 0; col < kDim; col++)
+		{
+			A[(size_t)row * kDim + col] = probability(generator) < rowDensity ? values(generator) : 0.0f;
+		}
+	}
+}
+
+static bool EqualResults(const vector<cl_float>& expected, const vector<cl_float>& C)
+{
+	for (size_t i = 0; i < C.size(); i++)
+	{
+		if (abs(expected[i] - C[i]) > 1e-3f * max(1.0f, abs(expected[i])))
+		{
+			cout << "Different value on index: " << i << "\n";
+			cout << expected[i] << " != " << C[i] << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+void BenchmarkSparse(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const SgemmShape& shape)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
+	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << " (sparse A in CSR)\n";
+
+	vector<cl_float> A((size_t)nDim * kDim);
+	vector<cl_float> B((size_t)kDim * mDim);
+	vector<cl_float> C((size_t)nDim * mDim);
+	vector<cl_float> sparseC((size_t)nDim * mDim);
+	mt19937 generator(12345);
+	uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	generate(B.begin(), B.end(), [&]() { return distribution(generator); });
+
+	size_t sizeA = A.size() * sizeof(float);
+	size_t sizeC = C.size() * sizeof(float);
+	cl::Buffer bufferA(context, CL_MEM_READ_ONLY, sizeA);
+	cl::Buffer bufferB(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, B.size() * sizeof(float), B.data());
+	cl::Buffer bufferC(context, CL_MEM_WRITE_ONLY, sizeC);
+	cl::Program& program = programCache.Get(device, "Spmm_csr", SgemmShape{ 0, 0, 0 }, KernelConfig(), false);
+	double crossover = 0.0;
+
+	for (double density : { 0.5, 0.2, 0.1, 0.05, 0.02, 0.01, 0.001 })
+	{
+		FillSparse(A, nDim, kDim, density, generator);
+		commandQueue.enqueueWriteBuffer(bufferA, true, 0, sizeA, (void*)A.data());
+
+		auto tStart = chrono::high_resolution_clock::now();
+		CsrMatrix csr = DenseToCsr(A.data(), nDim, kDim);
+		auto tEnd = chrono::high_resolution_clock::now();
+		DeviceCsr deviceCsr = UploadCsr(context, csr);
+		cl_ulong sparse = KernelSpmmCsr(context, device, program, commandQueue, deviceCsr, mDim, bufferB, bufferC, false);
+		commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)sparseC.data());
+
+		cout << "Density: " << Density(A.data(), A.size()) << ", longest row: "
+			<< csr.rowOffsets[csr.rowOrder[0] + 1] - csr.rowOffsets[csr.rowOrder[0]] << " of " << kDim
+			<< ", CSR construction: " << chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart).count() << " ns\n";
+		cout << "Spmm_csr: " << sparse << " ns (useful GFLOP/s: " << 2.0 * csr.values.size() * mDim / sparse << ")";
+
+		// Sgemm_local keeps a row of A in private memory, so it can fail to build or run for big K.
+		try
+		{
+			KernelConfig config = tuningTable.Get("Sgemm_local");
+			cl_ulong dense = KernelSgemmLocal(device, programCache.Get(device, "Sgemm_local", shape, config, false), commandQueue,
+				nDim, kDim, mDim, bufferA, bufferB, bufferC, config, false);
+			commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)C.data());
+			cout << ", Sgemm_local: " << dense << " ns, speedup: " << (double)dense / sparse << "\n";
+			cout << "Equality: " << boolalpha << EqualResults(C, sparseC) << "\n";
+			if (sparse < dense)
+			{
+				crossover = max(crossover, density);
+			}
+		}
+		catch (cl::Error& e)
+		{
+			cout << "\nSgemm_local skipped (" << e.err() << "): " << e.what() << "\n";
+		}
+
+		bool isSparse = false;
+		MultiplyDispatched(context, device, commandQueue, programCache, tuningTable, shape, A.data(), bufferB, bufferC, &isSparse);
+		cout << "Dispatcher: " << (isSparse ? "sparse" : "dense") << "\n";
+
+		if (COMPUTE_HOST)
+		{
+			vector<cl_float> hostC((size_t)nDim * mDim);
+			SgemmParallel(nDim, mDim, kDim, A.data(), B.data(), hostC.data());
+			cout << "Equality with host: " << boolalpha << EqualResults(hostC, sparseC) << "\n";
+		}
+	}
+
+	cout << "Spmm_csr was faster than Sgemm_local up to density " << crossover
+		<< " (dispatcher threshold SPARSE_MAX_DENSITY: " << SPARSE_MAX_DENSITY << ")\n";
+}
@@ -0,0 +1,291 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "Sgemm.h"
+
+using namespace std;
+
+// Block of a matrix stored in buffer, as the arguments of Sgemm_general.
+struct StrassenBlock
+{
+	cl::Buffer* buffer;
+	cl_uint offset;
+	cl_uint ld;
+};
+
+// Quadrant (row, col) of block with rows x cols values.
+static StrassenBlock Quadrant(const StrassenBlock& block, const cl_uint rows, const cl_uint cols, const cl_uint row, const cl_uint col)
+{
+	return StrassenBlock{ block.buffer, block.offset + row * (rows / 2) * block.ld + col * (cols / 2), block.ld };
+}
+
+// Every kernel is only enqueued, the in-order queue keeps the dependencies between them.
+class StrassenDriver
+{
+public:
+	StrassenDriver(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+		const KernelConfig& config, const SgemmShape& shape, const cl_uint levels);
+
+	void Multiply(const cl_uint level, const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+		const StrassenBlock& A, const StrassenBlock& B, const StrassenBlock& C);
+	// Waits for all kernels and returns the sum of their times.
+	cl_ulong Finish();
+
+private:
+	void Add(const cl_uint rows, const cl_uint cols, const StrassenBlock& X, const cl_float beta, const StrassenBlock& Y, const StrassenBlock& Z);
+
+	cl::CommandQueue& commandQueue;
+	KernelConfig config;
+	cl_uint levels;
+	cl::Kernel gemm;
+	cl::Kernel geam;
+	// Temporaries of every level: X holds combinations of A quadrants and later P1, Y of B quadrants.
+	vector<cl::Buffer> tempX;
+	vector<cl::Buffer> tempY;
+	vector<cl::Event> events;
+};
+
+StrassenDriver::StrassenDriver(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+	const KernelConfig& tunedConfig, const SgemmShape& shape, const cl_uint levels)
+	: commandQueue(commandQueue), config(tunedConfig), levels(levels)
+{
+	config.transA = false;
+	config.transB = false;
+	gemm = cl::Kernel(programCache.Get(device, "Sgemm_general", shape, config, false), "Sgemm_general");
+	geam = cl::Kernel(programCache.Get(device, "Sgeam", SgemmShape{ 0, 0, 0 }, KernelConfig(), false), "Sgeam");
+
+	size_t nDim = shape.nDim, kDim = shape.kDim, mDim = shape.mDim;
+	for (cl_uint level = 0; level < levels; level++)
+	{
+		nDim /= 2;
+		kDim /= 2;
+		mDim /= 2;
+		tempX.push_back(cl::Buffer(context, CL_MEM_READ_WRITE, nDim * max(kDim, mDim) * sizeof(float)));
+		tempY.push_back(cl::Buffer(context, CL_MEM_READ_WRITE, kDim * mDim * sizeof(float)));
+	}
+}
+
+void StrassenDriver::Add(const cl_uint rows, const cl_uint cols, const StrassenBlock& X, const cl_float beta, const StrassenBlock& Y, const StrassenBlock& Z)
+{
+	geam.setArg(0, sizeof(cl_uint), &rows);
+	geam.setArg(1, sizeof(cl_uint), &cols);
+	geam.setArg(2, *X.buffer);
+	geam.setArg(3, sizeof(cl_uint), &X.offset);
+	geam.setArg(4, sizeof(cl_uint), &X.ld);
+	geam.setArg(5, sizeof(cl_float), &beta);
+	geam.setArg(6, *Y.buffer);
+	geam.setArg(7, sizeof(cl_uint), &Y.offset);
+	geam.setArg(8, sizeof(cl_uint), &Y.ld);
+	geam.setArg(9, *Z.buffer);
+	geam.setArg(10, sizeof(cl_uint), &Z.offset);
+	geam.setArg(11, sizeof(cl_uint), &Z.ld);
+
+	cl::NDRange global = cl::NDRange(RoundUp(cols, GEAM_TILE_SIZE), RoundUp(rows, GEAM_TILE_SIZE));
+	cl::NDRange local = cl::NDRange(GEAM_TILE_SIZE, GEAM_TILE_SIZE);
+	cl::Event event;
+	commandQueue.enqueueNDRangeKernel(geam, cl::NullRange, global, local, NULL, &event);
+	events.push_back(event);
+}
+
+// Winograd's variant with the schedule of two temporaries per level: S and T combinations of quadrants
+// are built in X and Y, products P1 - P7 go into C quadrants (P1 into X) and are combined in place.
+void StrassenDriver::Multiply(const cl_uint level, const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	const StrassenBlock& A, const StrassenBlock& B, const StrassenBlock& C)
+{
+	if (level == levels)
+	{
+		cl::Event event;
+		EnqueueSgemmGeneral(commandQueue, gemm, nDim, kDim, mDim, 1.0f, *A.buffer, A.offset, A.ld,
+			*B.buffer, B.offset, B.ld, 0.0f, *C.buffer, C.offset, C.ld, config, NULL, &event);
+		events.push_back(event);
+		return;
+	}
+
+	const cl_uint n = nDim / 2, k = kDim / 2, m = mDim / 2;
+	StrassenBlock A11 = Quadrant(A, nDim, kDim, 0, 0), A12 = Quadrant(A, nDim, kDim, 0, 1);
+	StrassenBlock A21 = Quadrant(A, nDim, kDim, 1, 0), A22 = Quadrant(A, nDim, kDim, 1, 1);
+	StrassenBlock B11 = Quadrant(B, kDim, mDim, 0, 0), B12 = Quadrant(B, kDim, mDim, 0, 1);
+	StrassenBlock B21 = Quadrant(B, kDim, mDim, 1, 0), B22 = Quadrant(B, kDim, mDim, 1, 1);
+	StrassenBlock C11 = Quadrant(C, nDim, mDim, 0, 0), C12 = Quadrant(C, nDim, mDim, 0, 1);
+	StrassenBlock C21 = Quadrant(C, nDim, mDim, 1, 0), C22 = Quadrant(C, nDim, mDim, 1, 1);
+	StrassenBlock X{ &tempX[level], 0, k };
+	StrassenBlock Y{ &tempY[level], 0, m };
+	StrassenBlock P1{ &tempX[level], 0, m };
+
+	Add(n, k, A11, -1.0f, A21, X); // S3 = A11 - A21
+	Add(k, m, B22, -1.0f, B12, Y); // T3 = B22 - B12
+	Multiply(level + 1, n, k, m, X, Y, C21); // P7 = S3 * T3
+	Add(n, k, A21, 1.0f, A22, X); // S1 = A21 + A22
+	Add(k, m, B12, -1.0f, B11, Y); // T1 = B12 - B11
+	Multiply(level + 1, n, k, m, X, Y, C22); // P5 = S1 * T1
+	Add(n, k, X, -1.0f, A11, X); // S2 = S1 - A11
+	Add(k, m, B22, -1.0f, Y, Y); // T2 = B22 - T1
+	Multiply(level + 1, n, k, m, X, Y, C12); // P6 = S2 * T2
+	Add(n, k, A12, -1.0f, X, X); // S4 = A12 - S2
+	Multiply(level + 1, n, k, m, X, B22, C11); // P3 = S4 * B22
+	Multiply(level + 1, n, k, m, A11, B11, P1); // P1 = A11 * B11
+	Add(n, m, P1, 1.0f, C12, C12); // U2 = P1 + P6
+	Add(n, m, C12, 1.0f, C21, C21); // U3 = U2 + P7
+	Add(n, m, C12, 1.0f, C22, C12); // U4 = U2 + P5
+	Add(n, m, C21, 1.0f, C22, C22); // C22 = U7 = U3 + P5
+	Add(n, m, C12, 1.0f, C11, C12); // C12 = U5 = U4 + P3
+	Add(k, m, Y, -1.0f, B21, Y); // T4 = T2 - B21
+	Multiply(level + 1, n, k, m, A22, Y, C11); // P4 = A22 * T4
+	Add(n, m, C21, -1.0f, C11, C21); // C21 = U6 = U3 - P4
+	Multiply(level + 1, n, k, m, A12, B21, C11); // P2 = A12 * B21
+	Add(n, m, P1, 1.0f, C11, C11); // C11 = U1 = P1 + P2
+}
+
+cl_ulong StrassenDriver::Finish()
+{
+	commandQueue.finish();
+	cl_ulong elapsed = 0;
+	for (cl::Event& event : events)
+	{
+		elapsed += Profile(event, false);
+	}
+	events.clear();
+	return elapsed;
+}
+
+cl_uint StrassenLevels(const SgemmShape& shape, const cl_uint depth)
+{
+	cl_uint levels = 0;
+	cl_uint smallest = min(shape.nDim, min(shape.kDim, shape.mDim));
+	while (levels < depth && smallest / 2 >= STRASSEN_MIN_DIM)
+	{
+		smallest /= 2;
+		levels++;
+	}
+	return levels;
+}
+
+cl_ulong SgemmStrassen(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+	const KernelConfig& tunedConfig, const SgemmShape& shape, cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC,
+	const cl_uint depth)
+{
+	cl_uint levels = StrassenLevels(shape, depth);
+	cl_uint multiple = 1u << levels;
+	if (shape.nDim % multiple != 0 || shape.kDim % multiple != 0 || shape.mDim % multiple != 0)
+	{
+		throw runtime_error("Strassen SGEMM needs dimensions divisible by 2^levels!");
+	}
+
+	StrassenDriver driver(context, device, commandQueue, programCache, tunedConfig, shape, levels);
+	driver.Multiply(0, shape.nDim, shape.kDim, shape.mDim,
+		StrassenBlock{ &bufferA, 0, shape.kDim }, StrassenBlock{ &bufferB, 0, shape.mDim }, StrassenBlock{ &bufferC, 0, shape.mDim });
+	return driver.Finish();
+}
+
+// Maximum error of rows of C against the double result divided by the largest value of the result.
+static double SampledError(const vector<cl_float>& A, const vector<cl_float>& B, const vector<cl_float>& C,
+	const SgemmShape& shape, const vector<cl_uint>& rows)
+{
+	double maxError = 0.0, maxValue = 0.0;
+	vector<double> expected(shape.mDim);
+	for (cl_uint i : rows)
+	{
+		fill(expected.begin(), expected.end(), 0.0);
+		for (cl_uint k = 0; k < shape.kDim; k++)
+		{
+			double valueA = A[(size_t)i * shape.kDim + k];
+			const cl_float* rowB = &B[(size_t)k * shape.mDim];
+			for (cl_uint j = 0; j < shape.mDim; j++)
+			{
+				expected[j] += valueA * rowB[j];
+			}
+		}
+		for (cl_uint j = 0; j < shape.mDim; j++)
+		{
+			maxError = max(maxError, fabs(C[(size_t)i * shape.mDim + j] - expected[j]));
+			maxValue = max(maxValue, fabs(expected[j]));
+		}
+	}
+	return maxError / maxValue;
+}
+
+void BenchmarkStrassen(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const KernelConfig& tunedConfig, const SgemmShape& requested, const cl_uint maxDepth)
+{
+	// Dimensions are padded with zeros, so every level can halve them.
+	cl_uint multiple = 1u << StrassenLevels(requested, maxDepth);
+	SgemmShape shape{ (cl_uint)RoundUp(requested.nDim, multiple), (cl_uint)RoundUp(requested.kDim, multiple), (cl_uint)RoundUp(requested.mDim, multiple) };
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
+	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << " (Strassen-Winograd up to depth " << maxDepth << ")\n";
+
+	vector<cl_float> A((size_t)nDim * kDim, 0.0f);
+	vector<cl_float> B((size_t)kDim * mDim, 0.0f);
+	vector<cl_float> C((size_t)nDim * mDim);
+	mt19937 generator(12345);
+	uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	for (cl_uint i = 0; i < requested.nDim; i++)
+	{
+		for (cl_uint k = 0; k < requested.kDim; k++)
+		{
+			A[(size_t)i * kDim + k] = distribution(generator);
+		}
+	}
+	for (cl_uint k = 0; k < requested.kDim; k++)
+	{
+		for (cl_uint j = 0; j < requested.mDim; j++)
+		{
+			B[(size_t)k * mDim + j] = distribution(generator);
+		}
+	}
+
+	cl::Buffer bufferA(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, A.size() * sizeof(float), A.data());
+	cl::Buffer bufferB(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, B.size() * sizeof(float), B.data());
+	cl::Buffer bufferC(context, CL_MEM_READ_WRITE, C.size() * sizeof(float));
+
+	// Reference in double is computed only for a few rows, all of C would take as long as a host SGEMM.
+	vector<cl_uint> rows;
+	for (cl_uint i = 0; i < requested.nDim; i += max(requested.nDim / 16, 1u))
+	{
+		rows.push_back(i);
+	}
+
+	KernelConfig config = tunedConfig;
+	config.transA = false;
+	config.transB = false;
+	cl_ulong tiled = KernelSgemmTiled(device, programCache.Get(device, "Sgemm_tiled", shape, config, false), commandQueue,
+		nDim, kDim, mDim, bufferA, bufferB, bufferC, config, false);
+	commandQueue.enqueueReadBuffer(bufferC, true, 0, C.size() * sizeof(float), (void*)C.data());
+	cout << "Sgemm_tiled: " << tiled << " ns, GFLOP/s: " << Gflops(nDim, kDim, mDim, (double)tiled)
+		<< ", relative error: " << SampledError(A, B, C, shape, rows) << "\n";
+
+	// Warm up run builds the programs.
+	SgemmStrassen(context, device, commandQueue, programCache, config, shape, bufferA, bufferB, bufferC, 0);
+
+	cl_ulong classic = 0;
+	for (cl_uint depth = 0; depth <= maxDepth; depth++)
+	{
+		cl_uint levels = StrassenLevels(shape, depth);
+		if (levels < depth)
+		{
+			cout << "Depth " << depth << " would multiply blocks smaller than STRASSEN_MIN_DIM (" << STRASSEN_MIN_DIM << ")\n";
+			break;
+		}
+
+		auto tStart = chrono::high_resolution_clock::now();
+		cl_ulong elapsed = SgemmStrassen(context, device, commandQueue, programCache, config, shape, bufferA, bufferB, bufferC, depth);
+		auto tEnd = chrono::high_resolution_clock::now();
+		commandQueue.enqueueReadBuffer(bufferC, true, 0, C.size() * sizeof(float), (void*)C.data());
+		if (depth == 0)
+		{
+			classic = elapsed;
+		}
+
+		// GFLOP/s count the 2 * N * K * M operations of the classic algorithm, so they compare time.
+		cout << "Depth " << depth << (depth == 0 ? " (Sgemm_general)" : "") << ": " << elapsed << " ns in kernels, "
+			<< chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart).count() << " ns elapsed, effective GFLOP/s: "
+			<< Gflops(nDim, kDim, mDim, (double)elapsed) << ", speedup: " << (double)classic / elapsed
+			<< ", relative error: " << SampledError(A, B, C, shape, rows) << "\n";
+	}
+}
@@ -0,0 +1,165 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cmath>
+#include "Sgemm.h"
+
+using namespace std;
+
+// Random vector of +1 and -1, every wrong value of C changes C * r with probability at least 1/2.
+static void FillSigns(vector<cl_float>& r, mt19937& generator)
+{
+	bernoulli_distribution coin(0.5);
+	for (cl_float& value : r)
+	{
+		value = coin(generator) ? 1.0f : -1.0f;
+	}
+}
+
+// Rounding errors of A * (B * r) are bounded by |A| * (|B| * |r|) times a multiple of float epsilon,
+// so the difference is compared relative to it and not to C * r which can cancel out to 0.
+template <typename T>
+static bool CompareProducts(const cl_uint nDim, const T* product, const T* magnitude, const T* expected, const float tolerance)
+{
+	for (cl_uint i = 0; i < nDim; i++)
+	{
+		double difference = fabs((double)product[i] - (double)expected[i]);
+		if (difference > tolerance * (double)magnitude[i] || std::isnan(difference))
+		{
+			cout << "Freivalds' check failed on row " << i << ": A * (B * r) = " << product[i]
+				<< ", C * r = " << expected[i] << ", relative difference: " << difference / magnitude[i] << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FreivaldsHost(const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	const float* A, const float* B, const float* C, const VerifyOptions& options)
+{
+	mt19937 generator(random_device{}());
+	vector<cl_float> r(mDim);
+	vector<double> y(kDim), yAbs(kDim), z(nDim), zAbs(nDim), w(nDim);
+
+	for (int trial = 0; trial < options.trials; trial++)
+	{
+		FillSigns(r, generator);
+		for (cl_uint i = 0; i < kDim; i++)
+		{
+			double acc = 0.0, accAbs = 0.0;
+			for (cl_uint j = 0; j < mDim; j++)
+			{
+				acc += (double)B[(size_t)i * mDim + j] * r[j];
+				accAbs += fabs((double)B[(size_t)i * mDim + j]);
+			}
+			y[i] = acc;
+			yAbs[i] = accAbs;
+		}
+		for (cl_uint i = 0; i < nDim; i++)
+		{
+			double acc = 0.0, accAbs = 0.0, accC = 0.0;
+			for (cl_uint j = 0; j < kDim; j++)
+			{
+				acc += (double)A[(size_t)i * kDim + j] * y[j];
+				accAbs += fabs((double)A[(size_t)i * kDim + j]) * yAbs[j];
+			}
+			for (cl_uint j = 0; j < mDim; j++)
+			{
+				accC += (double)C[(size_t)i * mDim + j] * r[j];
+			}
+			z[i] = acc;
+			zAbs[i] = accAbs;
+			w[i] = accC;
+		}
+
+		if (!CompareProducts(nDim, z.data(), zAbs.data(), w.data(), options.tolerance))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// y = M * x and yAbs = |M| * xAbs, one work group per row of M.
+static void EnqueueMatvec(cl::CommandQueue& commandQueue, cl::Kernel& kernel, const cl_uint rows, const cl_uint cols,
+	cl::Buffer& bufferM, cl::Buffer& bufferX, cl::Buffer& bufferXAbs, cl::Buffer& bufferY, cl::Buffer& bufferYAbs)
+{
+	kernel.setArg(0, sizeof(cl_uint), &rows);
+	kernel.setArg(1, sizeof(cl_uint), &cols);
+	kernel.setArg(2, bufferM);
+	kernel.setArg(3, bufferX);
+	kernel.setArg(4, bufferXAbs);
+	kernel.setArg(5, bufferY);
+	kernel.setArg(6, bufferYAbs);
+
+	cl::NDRange global = cl::NDRange((size_t)rows * REDUCTION_LOCAL_SIZE);
+	cl::NDRange local = cl::NDRange(REDUCTION_LOCAL_SIZE);
+	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local);
+}
+
+bool FreivaldsDevice(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+	const SgemmShape& shape, cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const VerifyOptions& options)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cl::Kernel kernel(programCache.Get(device, "Freivalds_matvec", shape, KernelConfig(), false), "Freivalds_matvec");
+
+	cl::Buffer bufferR(context, CL_MEM_READ_ONLY, mDim * sizeof(float));
+	cl::Buffer bufferRAbs(context, CL_MEM_READ_ONLY, mDim * sizeof(float));
+	cl::Buffer bufferY(context, CL_MEM_READ_WRITE, kDim * sizeof(float));
+	cl::Buffer bufferYAbs(context, CL_MEM_READ_WRITE, kDim * sizeof(float));
+	cl::Buffer bufferZ(context, CL_MEM_WRITE_ONLY, nDim * sizeof(float));
+	cl::Buffer bufferZAbs(context, CL_MEM_WRITE_ONLY, nDim * sizeof(float));
+	cl::Buffer bufferW(context, CL_MEM_WRITE_ONLY, nDim * sizeof(float));
+	cl::Buffer bufferWAbs(context, CL_MEM_WRITE_ONLY, nDim * sizeof(float));
+	commandQueue.enqueueFillBuffer(bufferRAbs, 1.0f, 0, mDim * sizeof(float));
+
+	mt19937 generator(random_device{}());
+	vector<cl_float> r(mDim), z(nDim), zAbs(nDim), w(nDim);
+
+	for (int trial = 0; trial < options.trials; trial++)
+	{
+		FillSigns(r, generator);
+		commandQueue.enqueueWriteBuffer(bufferR, false, 0, mDim * sizeof(float), (void*)r.data());
+
+		EnqueueMatvec(commandQueue, kernel, kDim, mDim, bufferB, bufferR, bufferRAbs, bufferY, bufferYAbs);
+		EnqueueMatvec(commandQueue, kernel, nDim, kDim, bufferA, bufferY, bufferYAbs, bufferZ, bufferZAbs);
+		EnqueueMatvec(commandQueue, kernel, nDim, mDim, bufferC, bufferR, bufferRAbs, bufferW, bufferWAbs);
+
+		commandQueue.enqueueReadBuffer(bufferZ, false, 0, nDim * sizeof(float), (void*)z.data());
+		commandQueue.enqueueReadBuffer(bufferZAbs, false, 0, nDim * sizeof(float), (void*)zAbs.data());
+		commandQueue.enqueueReadBuffer(bufferW, true, 0, nDim * sizeof(float), (void*)w.data());
+
+		if (!CompareProducts(nDim, z.data(), zAbs.data(), w.data(), options.tolerance))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void VerifyHost(const SgemmShape& shape, const float* A, const float* B, const float* C, const VerifyOptions& options)
+{
+	auto tStart = chrono::high_resolution_clock::now();
+	bool passed = FreivaldsHost(shape.nDim, shape.kDim, shape.mDim, A, B, C, options);
+	auto tEnd = chrono::high_resolution_clock::now();
+
+	auto ns_int = chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart);
+	cout << "Freivalds' verification on host (" << options.trials << " trials, tolerance " << options.tolerance << "): "
+		<< (passed ? "passed" : "failed") << " in " << ns_int.count() << " ns\n";
+}
+
+void VerifyDevice(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+	const SgemmShape& shape, cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const VerifyOptions& options)
+{
+	auto tStart = chrono::high_resolution_clock::now();
+	bool passed = FreivaldsDevice(context, device, commandQueue, programCache, shape, bufferA, bufferB, bufferC, options);
+	auto tEnd = chrono::high_resolution_clock::now();
+
+	auto ns_int = chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart);
+	cout << "Freivalds' verification on device (" << options.trials << " trials, tolerance " << options.tolerance << "): "
+		<< (passed ? "passed" : "failed") << " in " << ns_int.count() << " ns\n";
+}
@@ -0,0 +1,150 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "Sgemm.h"
+#include "HostSgemm.h"
+
+using namespace std;
+
+// Times of commands which move C, A and B between host and device in one mode.
+struct TransferTimes
+{
+	cl_ulong upload = 0;
+	cl_ulong download = 0;
+	cl_ulong kernel = 0;
+};
+
+static void PrintTransferTimes(const char* mode, const TransferTimes& times)
+{
+	cout << mode << ": upload " << times.upload << " ns, kernel " << times.kernel << " ns, download " << times.download
+		<< " ns, total transfers " << times.upload + times.download << " ns\n";
+}
+
+static bool EqualResults(const cl_float* expected, const cl_float* C, size_t count)
+{
+	return memcmp(expected, C, count * sizeof(cl_float)) == 0;
+}
+
+void MultiplyShapeZeroCopy(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const KernelConfig& tunedConfig, const SgemmShape& shape, const VerifyOptions& verifyOptions)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
+	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << " (zero-copy)\n";
+	cout << "CL_DEVICE_HOST_UNIFIED_MEMORY: " << boolalpha << (bool)device.getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>() << "\n";
+
+	size_t sizeA = (size_t)nDim * kDim * sizeof(float);
+	size_t sizeB = (size_t)kDim * mDim * sizeof(float);
+	size_t sizeC = (size_t)nDim * mDim * sizeof(float);
+	cl::Program& program = programCache.Get(device, "Sgemm_tiled", shape, tunedConfig);
+
+	// Copies: host arrays are written into device buffers and C is read back.
+	TransferTimes copyTimes;
+	vector<cl_float> copyC((size_t)nDim * mDim);
+	{
+		cl_float* A = new cl_float[(size_t)nDim * kDim];
+		cl_float* B = new cl_float[(size_t)kDim * mDim];
+		FillOrdered(A, nDim, kDim, 0.00001f, 0.00001f);
+		FillOrdered(B, kDim, mDim, 0.00002f, 0.00002f);
+
+		cl::Buffer bufferA(context, CL_MEM_READ_ONLY, sizeA);
+		cl::Buffer bufferB(context, CL_MEM_READ_ONLY, sizeB);
+		cl::Buffer bufferC(context, CL_MEM_WRITE_ONLY, sizeC);
+
+		cl::Event writeA, writeB, readC;
+		commandQueue.enqueueWriteBuffer(bufferA, false, 0, sizeA, (void*)A, NULL, &writeA);
+		commandQueue.enqueueWriteBuffer(bufferB, true, 0, sizeB, (void*)B, NULL, &writeB);
+		copyTimes.upload = Profile(writeA, false) + Profile(writeB, false);
+		copyTimes.kernel = KernelSgemmTiled(device, program, commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC, tunedConfig, false);
+		commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)copyC.data(), NULL, &readC);
+		copyTimes.download = Profile(readC, false);
+		PrintTransferTimes("Copy", copyTimes);
+
+		if (verifyOptions.trials > 0)
+		{
+			VerifyHost(shape, A, B, copyC.data(), verifyOptions);
+		}
+
+		delete[] A;
+		delete[] B;
+	}
+
+	// CL_MEM_USE_HOST_PTR: device uses page aligned host arrays directly. Size is rounded up to the cache line,
+	// as required for zero-copy by some drivers. Map before the host reads C makes the results visible.
+	TransferTimes hostPtrTimes;
+	{
+		cl_float* A = (cl_float*)AlignedAlloc(RoundUp(sizeA, ZERO_COPY_SIZE_MULTIPLE), ZERO_COPY_ALIGNMENT);
+		cl_float* B = (cl_float*)AlignedAlloc(RoundUp(sizeB, ZERO_COPY_SIZE_MULTIPLE), ZERO_COPY_ALIGNMENT);
+		cl_float* C = (cl_float*)AlignedAlloc(RoundUp(sizeC, ZERO_COPY_SIZE_MULTIPLE), ZERO_COPY_ALIGNMENT);
+		if (A == nullptr || B == nullptr || C == nullptr)
+		{
+			AlignedFree(A);
+			AlignedFree(B);
+			AlignedFree(C);
+			throw runtime_error("Aligned host arrays for CL_MEM_USE_HOST_PTR can't be allocated!");
+		}
+		FillOrdered(A, nDim, kDim, 0.00001f, 0.00001f);
+		FillOrdered(B, kDim, mDim, 0.00002f, 0.00002f);
+
+		{
+			cl::Buffer bufferA(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, RoundUp(sizeA, ZERO_COPY_SIZE_MULTIPLE), A);
+			cl::Buffer bufferB(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, RoundUp(sizeB, ZERO_COPY_SIZE_MULTIPLE), B);
+			cl::Buffer bufferC(context, CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, RoundUp(sizeC, ZERO_COPY_SIZE_MULTIPLE), C);
+
+			hostPtrTimes.kernel = KernelSgemmTiled(device, program, commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC, tunedConfig, false);
+
+			cl::Event mapC, unmapC;
+			cl_float* mappedC = (cl_float*)commandQueue.enqueueMapBuffer(bufferC, true, CL_MAP_READ, 0, sizeC, NULL, &mapC);
+			hostPtrTimes.download = Profile(mapC, false);
+			cout << "Mapped pointer is the host pointer (no copy): " << boolalpha << (mappedC == C) << "\n";
+			cout << "Equality with copy: " << boolalpha << EqualResults(copyC.data(), mappedC, copyC.size()) << "\n";
+			commandQueue.enqueueUnmapMemObject(bufferC, mappedC, NULL, &unmapC);
+			unmapC.wait();
+			hostPtrTimes.download += Profile(unmapC, false);
+		}
+		PrintTransferTimes("CL_MEM_USE_HOST_PTR", hostPtrTimes);
+
+		AlignedFree(A);
+		AlignedFree(B);
+		AlignedFree(C);
+	}
+
+	// CL_MEM_ALLOC_HOST_PTR: driver allocates memory accessible by both sides, host fills A and B through maps.
+	TransferTimes allocHostPtrTimes;
+	{
+		cl::Buffer bufferA(context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, sizeA);
+		cl::Buffer bufferB(context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, sizeB);
+		cl::Buffer bufferC(context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, sizeC);
+
+		cl::Event mapA, mapB, unmapA, unmapB;
+		cl_float* A = (cl_float*)commandQueue.enqueueMapBuffer(bufferA, false, CL_MAP_WRITE_INVALIDATE_REGION, 0, sizeA, NULL, &mapA);
+		cl_float* B = (cl_float*)commandQueue.enqueueMapBuffer(bufferB, true, CL_MAP_WRITE_INVALIDATE_REGION, 0, sizeB, NULL, &mapB);
+		FillOrdered(A, nDim, kDim, 0.00001f, 0.00001f);
+		FillOrdered(B, kDim, mDim, 0.00002f, 0.00002f);
+		commandQueue.enqueueUnmapMemObject(bufferA, A, NULL, &unmapA);
+		commandQueue.enqueueUnmapMemObject(bufferB, B, NULL, &unmapB);
+		unmapB.wait();
+		allocHostPtrTimes.upload = Profile(mapA, false) + Profile(mapB, false) + Profile(unmapA, false) + Profile(unmapB, false);
+
+		allocHostPtrTimes.kernel = KernelSgemmTiled(device, program, commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC, tunedConfig, false);
+
+		cl::Event mapC, unmapC;
+		cl_float* C = (cl_float*)commandQueue.enqueueMapBuffer(bufferC, true, CL_MAP_READ, 0, sizeC, NULL, &mapC);
+		cout << "Equality with copy: " << boolalpha << EqualResults(copyC.data(), C, copyC.size()) << "\n";
+		commandQueue.enqueueUnmapMemObject(bufferC, C, NULL, &unmapC);
+		unmapC.wait();
+		allocHostPtrTimes.download = Profile(mapC, false) + Profile(unmapC, false);
+		PrintTransferTimes("CL_MEM_ALLOC_HOST_PTR", allocHostPtrTimes);
+	}
+
+	cl_ulong copyTransfers = copyTimes.upload + copyTimes.download;
+	cout << "Transfer time saved with CL_MEM_USE_HOST_PTR: "
+		<< (long long)copyTransfers - (long long)(hostPtrTimes.upload + hostPtrTimes.download) << " ns\n";
+	cout << "Transfer time saved with CL_MEM_ALLOC_HOST_PTR: "
+		<< (long long)copyTransfers - (long long)(allocHostPtrTimes.upload + allocHostPtrTimes.download) << " ns\n";
+	// Only CL_MEM_ALLOC_HOST_PTR works without host arrays, CL_MEM_USE_HOST_PTR still needs them.
+	cout << "Host memory saved with CL_MEM_ALLOC_HOST_PTR: " << sizeA + sizeB + sizeC << " B (no separate host arrays)\n";
+}
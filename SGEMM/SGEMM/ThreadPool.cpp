@@ -0,0 +1,138 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(unsigned threadCount)
+	: queuedItems(0), unfinishedItems(0), stopping(false)
+{
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+	}
+
+	for (unsigned i = 0; i < threadCount; i++)
+	{
+		queues.emplace_back(new WorkerQueue());
+	}
+	for (unsigned i = 0; i < threadCount; i++)
+	{
+		threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> guard(stateLock);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+
+	for (thread& worker : threads)
+	{
+		worker.join();
+	}
+}
+
+unsigned ThreadPool::Size() const
+{
+	return (unsigned)threads.size();
+}
+
+ThreadPool& ThreadPool::Instance()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::ParallelFor(size_t count, const Task& task)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	{
+		lock_guard<mutex> guard(stateLock);
+		unfinishedItems += count;
+		queuedItems += count;
+	}
+
+	// Consecutive indices go to the same worker (neighbouring tiles share data in caches),
+	// stealing fixes the imbalance.
+	size_t workers = queues.size();
+	for (size_t w = 0; w < workers; w++)
+	{
+		size_t begin = count * w / workers;
+		size_t end = count * (w + 1) / workers;
+
+		lock_guard<mutex> guard(queues[w]->lock);
+		for (size_t i = begin; i < end; i++)
+		{
+			queues[w]->items.push_back({ &task, i });
+		}
+	}
+
+	workAvailable.notify_all();
+
+	unique_lock<mutex> guard(stateLock);
+	workDone.wait(guard, [this] { return unfinishedItems == 0; });
+}
+
+bool ThreadPool::PopOwn(unsigned worker, WorkItem& item)
+{
+	WorkerQueue& queue = *queues[worker];
+	lock_guard<mutex> guard(queue.lock);
+	if (queue.items.empty())
+	{
+		return false;
+	}
+
+	item = queue.items.back();
+	queue.items.pop_back();
+	return true;
+}
+
+bool ThreadPool::Steal(unsigned worker, WorkItem& item)
+{
+	size_t workers = queues.size();
+	for (size_t offset = 1; offset < workers; offset++)
+	{
+		WorkerQueue& victim = *queues[(worker + offset) % workers];
+		lock_guard<mutex> guard(victim.lock);
+		if (!victim.items.empty())
+		{
+			item = victim.items.front();
+			victim.items.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::WorkerLoop(unsigned worker)
+{
+	while (true)
+	{
+		WorkItem item;
+		if (PopOwn(worker, item) || Steal(worker, item))
+		{
+			queuedItems--;
+			(*item.task)(item.index, worker);
+
+			lock_guard<mutex> guard(stateLock);
+			if (--unfinishedItems == 0)
+			{
+				workDone.notify_all();
+			}
+			continue;
+		}
+
+		unique_lock<mutex> guard(stateLock);
+		workAvailable.wait(guard, [this] { return stopping || queuedItems > 0; });
+		if (stopping)
+		{
+			return;
+		}
+	}
+}
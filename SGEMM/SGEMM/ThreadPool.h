@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker has its own queue: it takes tasks from the back of it
+// and when it's empty steals from the front of other workers queues, so uneven tasks are balanced.
+class ThreadPool
+{
+public:
+	// Task gets its index and id of the worker (0 .. Size() - 1) which runs it,
+	// so it can use per worker data (i.e. packing buffers) without locking.
+	typedef std::function<void(size_t index, unsigned worker)> Task;
+
+	explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned Size() const;
+
+	// Runs task for every index in [0, count) and waits until all of them are done.
+	// It must not be called from inside of a task.
+	void ParallelFor(size_t count, const Task& task);
+
+	// Pool shared by the whole program, sized to the hardware concurrency.
+	static ThreadPool& Instance();
+
+private:
+	struct WorkItem
+	{
+		const Task* task;
+		size_t index;
+	};
+
+	struct WorkerQueue
+	{
+		std::mutex lock;
+		std::deque<WorkItem> items;
+	};
+
+	void WorkerLoop(unsigned worker);
+	bool PopOwn(unsigned worker, WorkItem& item);
+	bool Steal(unsigned worker, WorkItem& item);
+
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	std::vector<std::thread> threads;
+
+	std::mutex stateLock;
+	std::condition_variable workAvailable;
+	std::condition_variable workDone;
+	std::atomic<size_t> queuedItems;
+	size_t unfinishedItems;
+	bool stopping;
+};
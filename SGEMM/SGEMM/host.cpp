@@ -1,14 +1,19 @@
-#define CL_HPP_ENABLE_EXCEPTIONS
-#define CL_HPP_TARGET_OPENCL_VERSION 200
-
-// Use opencl.hpp instead of cl2.hpp to make it clear that it supports all versions of OpenCL
-// #include <CL/cl2.hpp>
-#include <CL/opencl.hpp>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
 #include <chrono>
-#include "host.h"
+#include <cstring>
+#include <string>
+#include <map>
+#include <tuple>
+#include <sstream>
+#include <algorithm>
+#include "Sgemm.h"
+#include "HostSgemm.h"
+#include "ThreadPool.h"
+#include "../../common/ProgramBinaryCache.h"
+#include "../../common/KernelSource.h"
+#include "SGEMM.embedded.h"
 
 using namespace std;
 
@@ -105,6 +110,12 @@ void SgemmNaive(const int nDim, const int mDim, const int kDim, const float* A,
 	}
 }
 
+// Floating point operations of SGEMM (one multiplication and one addition per n * k * m) per nanosecond.
+double Gflops(const cl_uint nDim, const cl_uint kDim, const cl_uint mDim, const double elapsedNs)
+{
+	return 2.0 * nDim * kDim * mDim / elapsedNs;
+}
+
 void PrintMatrix(const float* matrix, const int nDim, const int mDim)
 {
 	for (int i = 0; i < nDim; i++)
@@ -118,17 +129,53 @@ void PrintMatrix(const float* matrix, const int nDim, const int mDim)
 	cout << endl;
 }
 
-void Profile(cl::Event& clEvent)
+cl_ulong Profile(cl::Event& clEvent, bool print)
 {
 	cl_ulong startTime = clEvent.getProfilingInfo<CL_PROFILING_COMMAND_START>();
 	cl_ulong endTime = clEvent.getProfilingInfo<CL_PROFILING_COMMAND_END>();
 	cl_ulong elapsed = endTime - startTime;
-	cout << "Time elapsed: " << elapsed << " ns\n";
+	if (print)
+	{
+		cout << "Time elapsed: " << elapsed << " ns\n";
+	}
+	return elapsed;
+}
+
+size_t RoundUp(size_t value, size_t multiple)
+{
+	return (value + multiple - 1) / multiple * multiple;
 }
 
-void KernelSgemmNaive(cl::Program& program, cl::CommandQueue& commandQueue,
+// Work group size doesn't have to divide nDim, global range is rounded up and kernels skip rows after nDim.
+// Without tuned value it starts from CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE (SIMD width of the device)
+// and grows while there are still at least 2 work groups per compute unit.
+size_t LocalSize1D(cl::Device& device, cl::Kernel& kernel, const cl_uint nDim, const KernelConfig& config, bool printInfo)
+{
+	if (config.localSize != 0)
+	{
+		return config.localSize;
+	}
+
+	cl_uint maxComputeUnits = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+	size_t maxLocalSize = min<size_t>(kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device), DEFAULT_MAX_LOCAL_SIZE);
+	size_t localSize = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device);
+	localSize = min(localSize, maxLocalSize);
+	while (localSize * 2 <= maxLocalSize && RoundUp(nDim, localSize * 2) / (localSize * 2) >= 2 * maxComputeUnits)
+	{
+		localSize *= 2;
+	}
+
+	if (printInfo)
+	{
+		cout << "CL_DEVICE_MAX_COMPUTE_UNITS: " << maxComputeUnits << "\n";
+		cout << "Local size: " << localSize << "\n";
+	}
+	return localSize;
+}
+
+cl_ulong KernelSgemmNaive(cl::Program& program, cl::CommandQueue& commandQueue,
 	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
-	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC)
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, bool printInfo)
 {
 	cl::Kernel kernel(program, "Sgemm_simple");
 
@@ -145,21 +192,17 @@ void KernelSgemmNaive(cl::Program& program, cl::CommandQueue& commandQueue,
 	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NullRange, NULL, &clEvent);
 	clEvent.wait();
 
-	Profile(clEvent);
+	return Profile(clEvent, printInfo);
 }
 
-void KernelSgemmComputeUnits(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
-	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
-	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC)
+// Sgemm_compute_units, Sgemm_private and Sgemm_local have the same arguments and 1D NDRange,
+// only Sgemm_local (and its _transposed and _half variants) needs additional local memory for column of B.
+cl_ulong KernelSgemm1D(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const char* kernelName, const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config, bool printInfo)
 {
-	cl_uint maxComputeUnits = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
-	cout << "CL_DEVICE_MAX_COMPUTE_UNITS: " << maxComputeUnits << "\n";
-	if (nDim % maxComputeUnits != 0)
-	{
-		throw runtime_error("nDim must be divisible by the CL_DEVICE_MAX_COMPUTE_UNITS without reminder!");
-	}
-
-	cl::Kernel kernel(program, "Sgemm_compute_units");
+	cl::Kernel kernel(program, kernelName);
+	size_t localSize = LocalSize1D(device, kernel, nDim, config, printInfo);
 
 	kernel.setArg(0, sizeof(cl_uint), &nDim);
 	kernel.setArg(1, sizeof(cl_uint), &kDim);
@@ -167,34 +210,68 @@ void KernelSgemmComputeUnits(cl::Device& device, cl::Program& program, cl::Comma
 	kernel.setArg(3, bufferA);
 	kernel.setArg(4, bufferB);
 	kernel.setArg(5, bufferC);
-	cout << kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) << "\n";
+	if (strncmp(kernelName, "Sgemm_local", strlen("Sgemm_local")) == 0)
+	{
+		kernel.setArg(6, kDim * sizeof(float), NULL);
+	}
 
-	cout << "CL_DEVICE_MAX_WORK_GROUP_SIZE: " << device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>() << "\n";
-	cout << "CL_KERNEL_WORK_GROUP_SIZE: " << kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) << "\n";
+	if (printInfo)
+	{
+		cout << "CL_DEVICE_MAX_WORK_GROUP_SIZE: " << device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>() << "\n";
+		cout << "CL_KERNEL_WORK_GROUP_SIZE: " << kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) << "\n";
+	}
 
-	cl::NDRange global = cl::NDRange(nDim);
-	cl::NDRange local = cl::NDRange(nDim/maxComputeUnits);
+	cl::NDRange global = cl::NDRange(RoundUp(nDim, localSize));
+	cl::NDRange local = cl::NDRange(localSize);
 	cl::Event clEvent;
 
 	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, NULL, &clEvent);
 	clEvent.wait();
 
-	Profile(clEvent);
+	return Profile(clEvent, printInfo);
 }
 
-// This is the same code as KernelSgemmComputeUnits but with different kernel.
-void KernelSgemmPrivate(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+cl_ulong KernelSgemmComputeUnits(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
 	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
-	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC)
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config, bool printInfo)
 {
-	cl_uint maxComputeUnits = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
-	cout << "CL_DEVICE_MAX_COMPUTE_UNITS: " << maxComputeUnits << "\n";
-	if (nDim % maxComputeUnits != 0)
-	{
-		throw runtime_error("nDim must be divisible by the CL_DEVICE_MAX_COMPUTE_UNITS without reminder!");
-	}
+	return KernelSgemm1D(device, program, commandQueue, "Sgemm_compute_units", nDim, kDim, mDim, bufferA, bufferB, bufferC, config, printInfo);
+}
+
+cl_ulong KernelSgemmPrivate(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config, bool printInfo)
+{
+	return KernelSgemm1D(device, program, commandQueue, "Sgemm_private", nDim, kDim, mDim, bufferA, bufferB, bufferC, config, printInfo);
+}
+
+cl_ulong KernelSgemmLocal(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config, bool printInfo)
+{
+	return KernelSgemm1D(device, program, commandQueue, "Sgemm_local", nDim, kDim, mDim, bufferA, bufferB, bufferC, config, printInfo);
+}
+
+cl_ulong KernelSgemmLocalHalf(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config, bool printInfo)
+{
+	return KernelSgemm1D(device, program, commandQueue, "Sgemm_local_half", nDim, kDim, mDim, bufferA, bufferB, bufferC, config, printInfo);
+}
+
+cl_ulong KernelSgemmLocalTransposed(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferBT, cl::Buffer& bufferC, const KernelConfig& config, bool printInfo)
+{
+	return KernelSgemm1D(device, program, commandQueue, "Sgemm_local_transposed", nDim, kDim, mDim, bufferA, bufferBT, bufferC, config, printInfo);
+}
 
-	cl::Kernel kernel(program, "Sgemm_private");
+// Sgemm_tiled and Sgemm_tiled_half have the same arguments and 2D NDRange of tiles.
+cl_ulong KernelSgemm2D(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const char* kernelName, const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config, bool printInfo)
+{
+	cl::Kernel kernel(program, kernelName);
 
 	kernel.setArg(0, sizeof(cl_uint), &nDim);
 	kernel.setArg(1, sizeof(cl_uint), &kDim);
@@ -203,75 +280,623 @@ void KernelSgemmPrivate(cl::Device& device, cl::Program& program, cl::CommandQue
 	kernel.setArg(4, bufferB);
 	kernel.setArg(5, bufferC);
 
-	cout << "CL_DEVICE_MAX_WORK_GROUP_SIZE: " << device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>() << "\n";
-	cout << "CL_KERNEL_WORK_GROUP_SIZE: " << kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) << "\n";
+	if (printInfo)
+	{
+		cout << "CL_DEVICE_MAX_WORK_GROUP_SIZE: " << device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>() << "\n";
+		cout << "CL_KERNEL_WORK_GROUP_SIZE: " << kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) << "\n";
+	}
 
-	cl::NDRange global = cl::NDRange(nDim);
-	cl::NDRange local = cl::NDRange(nDim / maxComputeUnits);
+	// Every work item computes workPerThread x workPerThread block of C.
+	// Dimension 0 is the column of C, dimension 1 is the row. Global range is rounded up to the whole tiles,
+	// kernel skips values outside of C.
+	cl_uint reducedTileSize = config.tileSize / config.workPerThread;
+	cl_uint tilesM = (mDim + config.tileSize - 1) / config.tileSize;
+	cl_uint tilesN = (nDim + config.tileSize - 1) / config.tileSize;
+	cl::NDRange global = cl::NDRange(tilesM * reducedTileSize, tilesN * reducedTileSize);
+	cl::NDRange local = cl::NDRange(reducedTileSize, reducedTileSize);
 	cl::Event clEvent;
 
 	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, NULL, &clEvent);
 	clEvent.wait();
 
-	Profile(clEvent);
+	return Profile(clEvent, printInfo);
 }
 
-void KernelSgemmLocal(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+cl_ulong KernelSgemmTiled(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
 	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
-	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC)
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config, bool printInfo)
 {
-	cl_uint maxComputeUnits = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
-	cout << "CL_DEVICE_MAX_COMPUTE_UNITS: " << maxComputeUnits << "\n";
-	if (nDim % maxComputeUnits != 0)
+	return KernelSgemm2D(device, program, commandQueue, "Sgemm_tiled", nDim, kDim, mDim, bufferA, bufferB, bufferC, config, printInfo);
+}
+
+cl_ulong KernelSgemmTiledHalf(cl::Device& device, cl::Program& program, cl::CommandQueue& commandQueue,
+	const cl_uint nDim, const cl_uint kDim, const cl_uint mDim,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC, const KernelConfig& config, bool printInfo)
+{
+	return KernelSgemm2D(device, program, commandQueue, "Sgemm_tiled_half", nDim, kDim, mDim, bufferA, bufferB, bufferC, config, printInfo);
+}
+
+struct SgemmOptions
+{
+	vector<SgemmShape> shapes;
+	bool tune = false;
+	cl_uint batchCount = 0;
+	bool general = false;
+	bool outOfCore = false;
+	cl_ulong memoryLimit = 0;
+	bool multiDevice = false;
+	bool zeroCopy = false;
+	bool epilogue = false;
+	cl_uint activation = ACTIVATION_NONE;
+	bool repack = false;
+	bool half = false;
+	bool int8 = false;
+	bool sparse = false;
+	cl_uint strassenDepth = 0;
+	bool factor = false;
+	cl_uint sessionBatches = 0;
+	bool benchmark = false;
+	BenchmarkOptions benchmarkOptions;
+	VerifyOptions verifyOptions;
+};
+
+// Command line: SGEMM.exe [--tune] [--batch COUNT] [--general] [--out-of-core MB] [--multi-device] [--zero-copy] [--repack] [--half] [--int8] [--sparse] [--strassen DEPTH] [--factor] [--epilogue ACTIVATION] [--session BATCHES] [--benchmark ...]
+//     [--verify TRIALS [--tolerance T] [--verify-host]] [N K M] [N K M] ...
+// Every triple of numbers is one multiplication, without arguments default N_DIM, K_DIM, M_DIM from host.h are used.
+// --tune searches the best launch parameters for the device on the first shape and saves them into TUNING_FILE.
+// --batch benchmarks batches of COUNT matrices of every shape instead of single multiplications.
+// --general runs BLAS SGEMM (alpha, beta, transposes, leading dimensions) on blocks of padded matrices,
+// checked on host (default shape GENERAL_N_DIM, GENERAL_K_DIM, GENERAL_M_DIM).
+// --out-of-core streams panels through at most MB megabytes of device memory. Shapes which don't fit
+// into the device are always computed this way (with half of the device memory).
+// --multi-device splits rows of C across every OpenCL device in the system.
+// --session keeps B (K x M) on device and streams BATCHES batches of A (N x K) through reused buffers.
+// --factor runs blocked LU and Cholesky of N x N matrices and compares their GFLOP/s with Sgemm_general.
+// --strassen compares up to DEPTH levels of Strassen-Winograd recursion with the classic kernels (time and error).
+// --sparse multiplies A with decreasing density in CSR format and compares it with dense Sgemm_local.
+// --epilogue multiplies with bias, ACTIVATION (none, relu or gelu) and residual fused into Sgemm_general
+// and compares it with separate element-wise passes over C.
+// --int8 quantizes A and B and runs int8 GEMM with float and int8 output.
+// --half runs kernels with A, B and C stored as half and reports their accuracy against float.
+// --repack transposes B on device once and compares kernels reading it by columns and by rows.
+// --zero-copy compares copied buffers with CL_MEM_USE_HOST_PTR and CL_MEM_ALLOC_HOST_PTR buffers accessed by maps.
+// --benchmark [--warmup N] [--repeats N] [--variant NAME] [--json FILE] [--csv FILE] measures all kernels
+// and host on the shapes (square 256 - 2048 and default shape without them) and saves results as JSON and CSV.
+// --verify checks every result with TRIALS trials of Freivalds' algorithm on device (or on host with --verify-host).
+SgemmOptions ParseArguments(int argc, char* argv[])
+{
+	SgemmOptions options;
+	vector<cl_uint> dimensions;
+
+	for (int i = 1; i < argc; i++)
 	{
-		throw runtime_error("nDim must be divisible by the CL_DEVICE_MAX_COMPUTE_UNITS without reminder!");
+		string argument = argv[i];
+		auto value = [&]()
+		{
+			if (++i == argc)
+			{
+				throw runtime_error(argument + " needs a value!");
+			}
+			return string(argv[i]);
+		};
+
+		if (argument == "--tune")
+		{
+			options.tune = true;
+		}
+		else if (argument == "--general")
+		{
+			options.general = true;
+		}
+		else if (argument == "--multi-device")
+		{
+			options.multiDevice = true;
+		}
+		else if (argument == "--session")
+		{
+			if (++i == argc || (options.sessionBatches = stoul(argv[i])) == 0)
+			{
+				throw runtime_error("--session needs number of batches greater than 0!");
+			}
+		}
+		else if (argument == "--int8")
+		{
+			options.int8 = true;
+		}
+		else if (argument == "--half")
+		{
+			options.half = true;
+		}
+		else if (argument == "--repack")
+		{
+			options.repack = true;
+		}
+		else if (argument == "--factor")
+		{
+			options.factor = true;
+		}
+		else if (argument == "--strassen")
+		{
+			if (++i == argc || (options.strassenDepth = stoul(argv[i])) == 0)
+			{
+				throw runtime_error("--strassen needs depth greater than 0!");
+			}
+		}
+		else if (argument == "--sparse")
+		{
+			options.sparse = true;
+		}
+		else if (argument == "--epilogue")
+		{
+			string activation = value();
+			if (activation == "none")
+			{
+				options.activation = ACTIVATION_NONE;
+			}
+			else if (activation == "relu")
+			{
+				options.activation = ACTIVATION_RELU;
+			}
+			else if (activation == "gelu")
+			{
+				options.activation = ACTIVATION_GELU;
+			}
+			else
+			{
+				throw runtime_error("--epilogue needs activation none, relu or gelu!");
+			}
+			options.epilogue = true;
+		}
+		else if (argument == "--zero-copy")
+		{
+			options.zeroCopy = true;
+		}
+		else if (argument == "--out-of-core")
+		{
+			if (++i == argc || (options.memoryLimit = stoull(argv[i]) * 1024 * 1024) == 0)
+			{
+				throw runtime_error("--out-of-core needs memory limit in MB greater than 0!");
+			}
+			options.outOfCore = true;
+		}
+		else if (argument == "--benchmark")
+		{
+			options.benchmark = true;
+		}
+		else if (argument == "--warmup")
+		{
+			options.benchmarkOptions.warmup = stoi(value());
+		}
+		else if (argument == "--repeats")
+		{
+			if ((options.benchmarkOptions.repeats = stoi(value())) <= 0)
+			{
+				throw runtime_error("--repeats must be greater than 0!");
+			}
+		}
+		else if (argument == "--variant")
+		{
+			options.benchmarkOptions.variant = value();
+		}
+		else if (argument == "--json")
+		{
+			options.benchmarkOptions.jsonFile = value();
+		}
+		else if (argument == "--csv")
+		{
+			options.benchmarkOptions.csvFile = value();
+		}
+		else if (argument == "--verify")
+		{
+			if ((options.verifyOptions.trials = stoi(value())) <= 0)
+			{
+				throw runtime_error("--verify needs number of trials greater than 0!");
+			}
+		}
+		else if (argument == "--tolerance")
+		{
+			options.verifyOptions.tolerance = stof(value());
+		}
+		else if (argument == "--verify-host")
+		{
+			options.verifyOptions.onHost = true;
+		}
+		else if (argument == "--batch")
+		{
+			if (++i == argc || (options.batchCount = stoul(argv[i])) == 0)
+			{
+				throw runtime_error("--batch needs number of matrices greater than 0!");
+			}
+		}
+		else
+		{
+			dimensions.push_back(stoul(argument));
+		}
 	}
 
-	cl::Kernel kernel(program, "Sgemm_local");
+	if (dimensions.size() % 3 != 0)
+	{
+		throw runtime_error("Matrix dimensions must be given as N K M triples!");
+	}
 
-	kernel.setArg(0, sizeof(cl_uint), &nDim);
-	kernel.setArg(1, sizeof(cl_uint), &kDim);
-	kernel.setArg(2, sizeof(cl_uint), &mDim);
-	kernel.setArg(3, bufferA);
-	kernel.setArg(4, bufferB);
-	kernel.setArg(5, bufferC);
-	kernel.setArg(6, kDim * sizeof(float), NULL);
+	for (size_t i = 0; i < dimensions.size(); i += 3)
+	{
+		SgemmShape shape{ dimensions[i], dimensions[i + 1], dimensions[i + 2] };
+		if (shape.nDim == 0 || shape.kDim == 0 || shape.mDim == 0)
+		{
+			throw runtime_error("Matrix dimensions must be greater than 0!");
+		}
+		options.shapes.push_back(shape);
+	}
 
-	cout << "CL_DEVICE_MAX_WORK_GROUP_SIZE: " << device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>() << "\n";
-	cout << "CL_KERNEL_WORK_GROUP_SIZE: " << kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) << "\n";
+	if (options.shapes.empty())
+	{
+		if (options.benchmark)
+		{
+			for (cl_uint dim = 256; dim <= 2048; dim *= 2)
+			{
+				options.shapes.push_back({ dim, dim, dim });
+			}
+		}
+		if (options.general)
+		{
+			options.shapes.push_back({ GENERAL_N_DIM, GENERAL_K_DIM, GENERAL_M_DIM });
+		}
+		else
+		{
+			options.shapes.push_back({ N_DIM, K_DIM, M_DIM });
+		}
+	}
+	return options;
+}
 
-	cl::NDRange global = cl::NDRange(nDim);
-	cl::NDRange local = cl::NDRange(nDim / maxComputeUnits);
-	cl::Event clEvent;
+// Sgemm_private and Sgemm_local(_transposed) keep entire row of A in private memory sized at compile time (K_DIM).
+// Other kernels don't depend on the shape and can share one build for every shape.
+bool IsShapeSpecialized(const string& kernelName)
+{
+	return kernelName == "Sgemm_private" || kernelName.compare(0, strlen("Sgemm_local"), "Sgemm_local") == 0;
+}
 
-	commandQueue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, NULL, &clEvent);
-	clEvent.wait();
+string BuildOptions(const string& kernelName, const SgemmShape& shape, const KernelConfig& config)
+{
+	string options;
+	if (IsShapeSpecialized(kernelName))
+	{
+		options = "-D K_DIM=" + to_string(shape.kDim);
+	}
+	else if (kernelName == "Sgemm_tiled" || kernelName == "Sgemm_tiled_half" || kernelName == "Sgemm_general")
+	{
+		options = "-D TILE_SIZE=" + to_string(config.tileSize)
+			+ " -D WORK_PER_THREAD=" + to_string(config.workPerThread)
+			+ " -D VECTOR_WIDTH=" + to_string(config.vectorWidth)
+			+ " -D UNROLL=" + to_string(config.unroll);
+		if (kernelName == "Sgemm_general")
+		{
+			options += " -D TRANS_A=" + to_string((int)config.transA) + " -D TRANS_B=" + to_string((int)config.transB);
+			if (config.HasEpilogue())
+			{
+				options += " -D EPILOGUE_BIAS=" + to_string(config.bias) + " -D EPILOGUE_ACTIVATION=" + to_string(config.activation)
+					+ " -D EPILOGUE_RESIDUAL=" + to_string((int)config.residual);
+			}
+		}
+	}
+	else if (kernelName == "Sgemm_tall")
+	{
+		options = "-D SKINNY_DIM=" + to_string(shape.mDim);
+	}
+	else if (kernelName == "Sgemm_wide")
+	{
+		options = "-D SKINNY_DIM=" + to_string(shape.nDim);
+	}
+	else if (kernelName == "Sgemm_batched")
+	{
+		options = "-D BATCH_TILE_SIZE=" + to_string(BatchTileSize(shape.nDim, shape.mDim));
+	}
+	return options;
+}
 
-	Profile(clEvent);
+bool ProgramKey::operator<(const ProgramKey& other) const
+{
+	return tie(device, kernelName, shape.nDim, shape.kDim, shape.mDim, options)
+		< tie(other.device, other.kernelName, other.shape.nDim, other.shape.kDim, other.shape.mDim, other.options);
 }
 
-int Program(int argc, char* argv[])
+ProgramCache::ProgramCache(cl::Context& context, const string& kernelSource)
+	: context(context), source(kernelSource)
 {
-	cl::Platform platform = FindOpenCLPlatform();
+}
 
-	cl_context_properties contextProperties[] = { CL_CONTEXT_PLATFORM, (cl_context_properties)(platform)(), 0 };
-	cl::Context context(CL_DEVICE_TYPE_GPU, contextProperties);
-	vector<cl::Device> devices = context.getInfo<CL_CONTEXT_DEVICES>();
-	cl::Device device = devices[0];
+cl::Program& ProgramCache::Get(cl::Device& device, const string& kernelName, const SgemmShape& shape,
+	const KernelConfig& config, bool printInfo)
+{
+	ProgramKey key{ device(), kernelName, { 0, 0, 0 }, BuildOptions(kernelName, shape, config) };
+	if (IsShapeSpecialized(kernelName))
+	{
+		key.shape = shape;
+	}
 
-	cout << "\n";
-	const cl_uint nDim = N_DIM;
-	const cl_uint kDim = K_DIM;
-	const cl_uint mDim = M_DIM;
+	auto found = programs.find(key);
+	if (found != programs.end())
+	{
+		return found->second;
+	}
+
+	// SGEMM.spv is compiled offline with the defaults, so only programs without -D options can use it.
+	cl::Program program;
+	ProgramOrigin origin = ProgramFromSource;
+	auto tStart = chrono::high_resolution_clock::now();
+	try
+	{
+		origin = BuildProgramCached(program, context, device, source, key.options, key.options.empty() ? KernelILPath("SGEMM.spv") : "");
+	}
+	catch (cl::Error&)
+	{
+		cout << "Build log:\n" << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << "\n";
+		throw;
+	}
+	auto tEnd = chrono::high_resolution_clock::now();
+	if (printInfo)
+	{
+		auto ns_int = chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart);
+		const char* how = origin == ProgramFromBinary ? "loaded from binary cache" : origin == ProgramFromIL ? "built from SPIR-V" : "built";
+		cout << "Program " << how << " for " << kernelName << " (options: \"" << key.options << "\") in " << ns_int.count() << " ns\n";
+	}
 
+	return programs.emplace(key, program).first->second;
+}
+
+TuningTable::TuningTable(cl::Device& device)
+	: deviceName(device.getInfo<CL_DEVICE_NAME>()), driverVersion(device.getInfo<CL_DRIVER_VERSION>())
+{
+}
+
+void TuningTable::Load(const string& fileName)
+{
+	ifstream file(fileName);
+	string line;
+	while (getline(file, line))
+	{
+		vector<string> fields;
+		size_t begin = 0, end;
+		while ((end = line.find('|', begin)) != string::npos)
+		{
+			fields.push_back(line.substr(begin, end - begin));
+			begin = end + 1;
+		}
+		fields.push_back(line.substr(begin));
+
+		if (fields.size() != 5 || fields[0] != deviceName || fields[1] != driverVersion)
+		{
+			continue;
+		}
+
+		KernelConfig config;
+		istringstream values(fields[3]);
+		if (values >> config.localSize >> config.tileSize >> config.workPerThread >> config.vectorWidth >> config.unroll)
+		{
+			configs[fields[2]] = { config, stoull(fields[4]) };
+		}
+	}
+
+	if (!configs.empty())
+	{
+		cout << "Loaded tuned parameters of " << configs.size() << " kernels from " << fileName << "\n";
+	}
+}
+
+// Lines of other devices are kept, lines of this device are replaced.
+void TuningTable::Save(const string& fileName) const
+{
+	vector<string> lines;
+	{
+		ifstream file(fileName);
+		string line;
+		string prefix = deviceName + "|" + driverVersion + "|";
+		while (getline(file, line))
+		{
+			if (line.compare(0, prefix.size(), prefix) != 0)
+			{
+				lines.push_back(line);
+			}
+		}
+	}
+
+	ofstream file(fileName, ios::trunc);
+	for (const string& line : lines)
+	{
+		file << line << "\n";
+	}
+	for (const auto& entry : configs)
+	{
+		const KernelConfig& config = entry.second.first;
+		file << deviceName << "|" << driverVersion << "|" << entry.first << "|"
+			<< config.localSize << " " << config.tileSize << " " << config.workPerThread << " "
+			<< config.vectorWidth << " " << config.unroll << "|" << entry.second.second << "\n";
+	}
+}
+
+KernelConfig TuningTable::Get(const string& kernelName) const
+{
+	auto found = configs.find(kernelName);
+	return found != configs.end() ? found->second.first : KernelConfig();
+}
+
+void TuningTable::Set(const string& kernelName, const KernelConfig& config, cl_ulong elapsed)
+{
+	configs[kernelName] = { config, elapsed };
+}
+
+// Runs candidate TUNING_REPEATS times and returns the best time, candidates which can't be built or launched
+// on this device (too much local/private memory, too big work group) return 0.
+cl_ulong MeasureCandidate(cl::Device& device, cl::CommandQueue& commandQueue, ProgramCache& programCache,
+	const string& kernelName, const SgemmShape& shape, const KernelConfig& config,
+	cl::Buffer& bufferA, cl::Buffer& bufferB, cl::Buffer& bufferC)
+{
+	cl_ulong best = 0;
+	try
+	{
+		cl::Program& program = programCache.Get(device, kernelName, shape, config, false);
+		for (int repeat = 0; repeat < TUNING_REPEATS; repeat++)
+		{
+			cl_ulong elapsed;
+			if (kernelName == "Sgemm_tiled")
+			{
+				elapsed = KernelSgemmTiled(device, program, commandQueue, shape.nDim, shape.kDim, shape.mDim, bufferA, bufferB, bufferC, config, false);
+			}
+			else
+			{
+				elapsed = KernelSgemm1D(device, program, commandQueue, kernelName.c_str(), shape.nDim, shape.kDim, shape.mDim, bufferA, bufferB, bufferC, config, false);
+			}
+			best = (best == 0 || elapsed < best) ? elapsed : best;
+		}
+	}
+	catch (cl::Error& e)
+	{
+		cout << "  skipped (" << e.err() << "): " << e.what() << "\n";
+		return 0;
+	}
+	return best;
+}
+
+void PrintCandidate(const string& kernelName, const KernelConfig& config, cl_ulong elapsed)
+{
+	cout << kernelName << " local: " << config.localSize << ", tile: " << config.tileSize
+		<< ", work per thread: " << config.workPerThread << ", vector width: " << config.vectorWidth
+		<< ", unroll: " << config.unroll << " -> " << elapsed << " ns\n";
+}
+
+// Sweeps work group size of 1D kernels and tile size, work per thread, vector width and unroll of Sgemm_tiled.
+// Tile parameters are searched in two passes (tile size x work per thread, then vector width x unroll)
+// to keep the number of builds small.
+void TuneKernels(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const SgemmShape& shape, TuningTable& tuningTable)
+{
+	cout << "\nTuning on N: " << shape.nDim << ", K: " << shape.kDim << ", M: " << shape.mDim << "\n";
+
+	size_t sizeA = (size_t)shape.nDim * shape.kDim * sizeof(float);
+	size_t sizeB = (size_t)shape.kDim * shape.mDim * sizeof(float);
+	size_t sizeC = (size_t)shape.nDim * shape.mDim * sizeof(float);
+
+	cl::Buffer bufferA(context, CL_MEM_READ_ONLY, sizeA);
+	cl::Buffer bufferB(context, CL_MEM_READ_ONLY, sizeB);
+	cl::Buffer bufferC(context, CL_MEM_WRITE_ONLY, sizeC);
+	commandQueue.enqueueFillBuffer(bufferA, 1.0f, 0, sizeA);
+	commandQueue.enqueueFillBuffer(bufferB, 1.0f, 0, sizeB);
+	commandQueue.finish();
+
+	size_t maxWorkGroupSize = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+	cl_ulong localMemSize = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+
+	for (const string kernelName : { "Sgemm_compute_units", "Sgemm_private", "Sgemm_local" })
+	{
+		// Candidates: device default (0) and powers of 2.
+		vector<size_t> localSizes{ 0 };
+		for (size_t localSize = 8; localSize <= maxWorkGroupSize; localSize *= 2)
+		{
+			localSizes.push_back(localSize);
+		}
+
+		KernelConfig bestConfig;
+		cl_ulong bestTime = 0;
+		for (size_t localSize : localSizes)
+		{
+			KernelConfig config;
+			config.localSize = localSize;
+
+			cl_ulong elapsed = MeasureCandidate(device, commandQueue, programCache, kernelName, shape, config, bufferA, bufferB, bufferC);
+			if (elapsed == 0)
+			{
+				continue;
+			}
+			PrintCandidate(kernelName, config, elapsed);
+			if (bestTime == 0 || elapsed < bestTime)
+			{
+				bestConfig = config;
+				bestTime = elapsed;
+			}
+		}
+
+		if (bestTime != 0)
+		{
+			tuningTable.Set(kernelName, bestConfig, bestTime);
+		}
+	}
+
+	KernelConfig bestConfig;
+	cl_ulong bestTime = 0;
+	auto tryTiled = [&](const KernelConfig& config)
+	{
+		size_t workGroupSize = (size_t)(config.tileSize / config.workPerThread) * (config.tileSize / config.workPerThread);
+		if (config.tileSize % config.workPerThread != 0 || config.tileSize % config.vectorWidth != 0
+			|| workGroupSize > maxWorkGroupSize || 2 * config.tileSize * config.tileSize * sizeof(float) > localMemSize)
+		{
+			return;
+		}
+
+		cl_ulong elapsed = MeasureCandidate(device, commandQueue, programCache, "Sgemm_tiled", shape, config, bufferA, bufferB, bufferC);
+		if (elapsed == 0)
+		{
+			return;
+		}
+		PrintCandidate("Sgemm_tiled", config, elapsed);
+		if (bestTime == 0 || elapsed < bestTime)
+		{
+			bestConfig = config;
+			bestTime = elapsed;
+		}
+	};
+
+	for (cl_uint tileSize : { 16, 32, 64 })
+	{
+		for (cl_uint workPerThread : { 1, 2, 4, 8 })
+		{
+			KernelConfig config;
+			config.tileSize = tileSize;
+			config.workPerThread = workPerThread;
+			config.vectorWidth = 1;
+			config.unroll = 1;
+			tryTiled(config);
+		}
+	}
+
+	KernelConfig bestTile = bestConfig;
+	for (cl_uint vectorWidth : { 1, 2, 4, 8 })
+	{
+		for (cl_uint unroll : { 1, 4, 8 })
+		{
+			KernelConfig config = bestTile;
+			config.vectorWidth = vectorWidth;
+			config.unroll = unroll;
+			if (vectorWidth == 1 && unroll == 1)
+			{
+				continue;
+			}
+			tryTiled(config);
+		}
+	}
+
+	if (bestTime != 0)
+	{
+		tuningTable.Set("Sgemm_tiled", bestConfig, bestTime);
+	}
+}
+
+void MultiplyShape(cl::Context& context, cl::Device& device, cl::CommandQueue& commandQueue,
+	ProgramCache& programCache, const TuningTable& tuningTable, const SgemmShape& shape, const VerifyOptions& verifyOptions)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
 	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << "\n";
 
-	cl_float* A = new cl_float[nDim * kDim];
-	cl_float* B = new cl_float[kDim * mDim];
-	cl_float* C = new cl_float[nDim * mDim];
-	size_t sizeA = nDim * kDim * sizeof(float);
-	size_t sizeB = kDim * mDim * sizeof(float);
-	size_t sizeC = nDim * mDim * sizeof(float);
+	cl_float* A = new cl_float[(size_t)nDim * kDim];
+	cl_float* B = new cl_float[(size_t)kDim * mDim];
+	cl_float* C = new cl_float[(size_t)nDim * mDim];
+	size_t sizeA = (size_t)nDim * kDim * sizeof(float);
+	size_t sizeB = (size_t)kDim * mDim * sizeof(float);
+	size_t sizeC = (size_t)nDim * mDim * sizeof(float);
 
 	FillOrdered(A, nDim, kDim, 0.00001f, 0.00001f);
 	FillOrdered(B, kDim, mDim, 0.00002f, 0.00002f);
@@ -285,20 +910,24 @@ int Program(int argc, char* argv[])
 		PrintMatrix(C, nDim, mDim);
 	}
 
-	cl_float* hostC;
+	cl_float* hostC = nullptr;
 	// Host multiplication
 	if (COMPUTE_HOST)
 	{
-		hostC = new cl_float[nDim * mDim];
+		hostC = new cl_float[(size_t)nDim * mDim];
 		//FillEmpty(hostC, nDim, mDim);
 		std::memcpy(hostC, C, sizeC);
-		cout << "Naive host matrix multiplication:\n";
+		cout << "Parallel host matrix multiplication (" << SimdLevelName(DetectSimdLevel()) << ", "
+			<< ThreadPool::Instance().Size() << " threads):\n";
 		auto tStart = chrono::high_resolution_clock::now();
-		SgemmNaive(nDim, mDim, kDim, A, B, hostC);
+		//SgemmNaive(nDim, mDim, kDim, A, B, hostC);
+		//SgemmBlocked(nDim, mDim, kDim, A, B, hostC);
+		SgemmParallel(nDim, mDim, kDim, A, B, hostC);
 		auto tEnd = chrono::high_resolution_clock::now();
 
 		auto ns_int = chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart);
-		cout << "Naive time elapsed: " << ns_int.count() << " ns\n";
+		cout << "Host time elapsed: " << ns_int.count() << " ns\n";
+		cout << "Host GFLOP/s: " << Gflops(nDim, kDim, mDim, (double)ns_int.count()) << "\n";
 
 		if (VERBOSE) PrintMatrix(hostC, nDim, mDim);
 	}
@@ -309,27 +938,16 @@ int Program(int argc, char* argv[])
 	cl::Buffer bufferB(context, CL_MEM_READ_ONLY, sizeB);
 	cl::Buffer bufferC(context, CL_MEM_WRITE_ONLY, sizeC);
 
-	cl_command_queue_properties properties = CL_QUEUE_PROFILING_ENABLE;
-	cl::CommandQueue commandQueue(context, device, properties);
-
 	commandQueue.enqueueWriteBuffer(bufferA, true, 0, sizeA, (void*)A);
 	commandQueue.enqueueWriteBuffer(bufferB, true, 0, sizeB, (void*)B);
 
-	// Read source file
-	ifstream sourceFile("SGEMM.cl");
-	string kernelSource(
-		istreambuf_iterator<char>(sourceFile),
-		(istreambuf_iterator<char>()));
-	cl::Program::Sources source{ kernelSource };
-	cl::Program program = cl::Program(context, source);
-	// Build binary version of program.
-	program.build(device);
-
 	// Main kernel program
-	//KernelSgemmNaive(program, commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC);
-	//KernelSgemmComputeUnits(device, program, commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC);
-	//KernelSgemmPrivate(device, program, commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC);
-	KernelSgemmLocal(device, program, commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC);
+	//KernelSgemmNaive(programCache.Get(device, "Sgemm_simple", shape), commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC);
+	//KernelSgemmComputeUnits(device, programCache.Get(device, "Sgemm_compute_units", shape), commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC, tuningTable.Get("Sgemm_compute_units"));
+	//KernelSgemmPrivate(device, programCache.Get(device, "Sgemm_private", shape), commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC, tuningTable.Get("Sgemm_private"));
+	//KernelSgemmLocal(device, programCache.Get(device, "Sgemm_local", shape), commandQueue, nDim, kDim, mDim, bufferA, bufferB, bufferC, tuningTable.Get("Sgemm_local"));
+	cl_ulong elapsed = KernelSgemm(device, programCache, commandQueue, tuningTable, shape, bufferA, bufferB, bufferC);
+	cout << "Kernel GFLOP/s: " << Gflops(nDim, kDim, mDim, (double)elapsed) << "\n";
 
 	// Read and check results
 	commandQueue.enqueueReadBuffer(bufferC, true, 0, sizeC, (void*)C);
@@ -338,10 +956,22 @@ int Program(int argc, char* argv[])
 		PrintMatrix(C, nDim, mDim);
 	}
 
+	if (verifyOptions.trials > 0)
+	{
+		if (verifyOptions.onHost)
+		{
+			VerifyHost(shape, A, B, C, verifyOptions);
+		}
+		else
+		{
+			VerifyDevice(context, device, commandQueue, programCache, shape, bufferA, bufferB, bufferC, verifyOptions);
+		}
+	}
+
 	if (COMPUTE_HOST)
 	{
 		bool isEqual = true;
-		for (size_t i = 0; i < nDim * mDim; i++)
+		for (size_t i = 0; i < (size_t)nDim * mDim; i++)
 		{
 			if (abs(hostC[i] - C[i]) > 100.0f)
 			{
@@ -353,11 +983,176 @@ int Program(int argc, char* argv[])
 			}
 		}
 		cout << "Equality: " << boolalpha << isEqual << "\n";
+		delete[] hostC;
 	}
 
 	delete[] A;
 	delete[] B;
 	delete[] C;
+}
+
+// Used when there is no OpenCL device, matrices are multiplied with SgemmParallel on CPU.
+void MultiplyShapeHost(const SgemmShape& shape, const VerifyOptions& verifyOptions)
+{
+	const cl_uint nDim = shape.nDim;
+	const cl_uint kDim = shape.kDim;
+	const cl_uint mDim = shape.mDim;
+
+	cout << "\n";
+	cout << "N: " << nDim << ", K: " << kDim << ", M: " << mDim << "\n";
+
+	cl_float* A = new cl_float[(size_t)nDim * kDim];
+	cl_float* B = new cl_float[(size_t)kDim * mDim];
+	cl_float* C = new cl_float[(size_t)nDim * mDim];
+
+	FillOrdered(A, nDim, kDim, 0.00001f, 0.00001f);
+	FillOrdered(B, kDim, mDim, 0.00002f, 0.00002f);
+
+	cout << "Parallel host matrix multiplication (" << SimdLevelName(DetectSimdLevel()) << ", "
+		<< ThreadPool::Instance().Size() << " threads):\n";
+	auto tStart = chrono::high_resolution_clock::now();
+	SgemmParallel(nDim, mDim, kDim, A, B, C);
+	auto tEnd = chrono::high_resolution_clock::now();
+
+	auto ns_int = chrono::duration_cast<chrono::nanoseconds>(tEnd - tStart);
+	cout << "Host time elapsed: " << ns_int.count() << " ns\n";
+	cout << "Host GFLOP/s: " << Gflops(nDim, kDim, mDim, (double)ns_int.count()) << "\n";
+
+	if (VERBOSE) PrintMatrix(C, nDim, mDim);
+
+	if (verifyOptions.trials > 0)
+	{
+		VerifyHost(shape, A, B, C, verifyOptions);
+	}
+
+	delete[] A;
+	delete[] B;
+	delete[] C;
+}
+
+int Program(int argc, char* argv[])
+{
+	SgemmOptions options = ParseArguments(argc, argv);
+
+	if (options.multiDevice)
+	{
+		string kernelSource = LoadKernelSource("SGEMM.cl", embeddedKernelSource);
+		for (const SgemmShape& shape : options.shapes)
+		{
+			MultiplyShapeMultiDevice(kernelSource, shape, options.verifyOptions);
+		}
+		return 0;
+	}
+
+	cl::Platform platform;
+	try
+	{
+		platform = FindOpenCLPlatform();
+	}
+	catch (const exception& e)
+	{
+		cout << e.what() << "\n";
+		cout << "Falling back to host computation.\n";
+		for (const SgemmShape& shape : options.shapes)
+		{
+			MultiplyShapeHost(shape, options.verifyOptions);
+		}
+		return 0;
+	}
+
+	cl_context_properties contextProperties[] = { CL_CONTEXT_PLATFORM, (cl_context_properties)(platform)(), 0 };
+	cl::Context context(CL_DEVICE_TYPE_GPU, contextProperties);
+	vector<cl::Device> devices = context.getInfo<CL_CONTEXT_DEVICES>();
+	cl::Device device = devices[0];
+
+	cl_command_queue_properties properties = CL_QUEUE_PROFILING_ENABLE;
+	cl::CommandQueue commandQueue(context, device, properties);
+
+	string kernelSource = LoadKernelSource("SGEMM.cl", embeddedKernelSource);
+	// Programs are built on first use for every shape.
+	ProgramCache programCache(context, kernelSource);
+
+	// Launch parameters found by previous --tune runs on this device.
+	TuningTable tuningTable(device);
+	tuningTable.Load(TUNING_FILE);
+
+	if (options.tune)
+	{
+		TuneKernels(context, device, commandQueue, programCache, options.shapes[0], tuningTable);
+		tuningTable.Save(TUNING_FILE);
+		cout << "Tuned parameters saved to " << TUNING_FILE << "\n";
+	}
+
+	if (options.benchmark)
+	{
+		BenchmarkShapes(context, device, commandQueue, programCache, tuningTable, options.shapes, options.benchmarkOptions);
+		return 0;
+	}
+
+	for (const SgemmShape& shape : options.shapes)
+	{
+		if (options.batchCount != 0)
+		{
+			BenchmarkBatched(context, device, commandQueue, programCache, shape, options.batchCount);
+			continue;
+		}
+		if (options.outOfCore || !FitsDevice(device, shape))
+		{
+			MultiplyShapeOutOfCore(context, device, commandQueue, programCache, tuningTable.Get("Sgemm_tiled"), shape, options.memoryLimit, options.verifyOptions);
+			continue;
+		}
+		if (options.sessionBatches != 0)
+		{
+			RunSession(context, device, programCache, tuningTable.Get("Sgemm_tiled"), shape, options.sessionBatches, options.verifyOptions);
+			continue;
+		}
+		if (options.factor)
+		{
+			BenchmarkFactorizations(context, device, commandQueue, programCache, tuningTable.Get("Sgemm_tiled"), shape.nDim);
+			continue;
+		}
+		if (options.strassenDepth != 0)
+		{
+			BenchmarkStrassen(context, device, commandQueue, programCache, tuningTable.Get("Sgemm_tiled"), shape, options.strassenDepth);
+			continue;
+		}
+		if (options.sparse)
+		{
+			BenchmarkSparse(context, device, commandQueue, programCache, tuningTable, shape);
+			continue;
+		}
+		if (options.epilogue)
+		{
+			MultiplyShapeEpilogue(context, device, commandQueue, programCache, tuningTable.Get("Sgemm_tiled"), shape, options.activation);
+			continue;
+		}
+		if (options.int8)
+		{
+			BenchmarkQuantized(context, device, commandQueue, programCache, tuningTable, shape);
+			continue;
+		}
+		if (options.half)
+		{
+			MultiplyShapeHalf(context, device, commandQueue, programCache, tuningTable, shape);
+			continue;
+		}
+		if (options.repack)
+		{
+			MultiplyShapeRepacked(context, device, commandQueue, programCache, tuningTable, shape);
+			continue;
+		}
+		if (options.zeroCopy)
+		{
+			MultiplyShapeZeroCopy(context, device, commandQueue, programCache, tuningTable.Get("Sgemm_tiled"), shape, options.verifyOptions);
+			continue;
+		}
+		if (options.general)
+		{
+			MultiplyShapeGeneral(context, device, commandQueue, programCache, tuningTable.Get("Sgemm_tiled"), shape);
+			continue;
+		}
+		MultiplyShape(context, device, commandQueue, programCache, tuningTable, shape, options.verifyOptions);
+	}
 
 	return 0;
 }
@@ -2,6 +2,175 @@
 
 #define VERBOSE false
 #define COMPUTE_HOST false
+
+// Default matrix dimensions, they can be changed at runtime with command line arguments (SGEMM.exe N K M).
+// Kernels which need K_DIM at compile time get it with -D K_DIM=... build option.
+#ifndef N_DIM
 #define N_DIM 4800
+#endif
+#ifndef K_DIM
 #define K_DIM 1200
-#define M_DIM 3600
\ No newline at end of file
+#endif
+#ifndef M_DIM
+#define M_DIM 3600
+#endif
+// Default dimensions of SGEMM.exe --general, which compares every result with naive SGEMM on host.
+// They aren't multiples of tile sizes, so partial tiles at the edges of the blocks are checked too.
+#define GENERAL_N_DIM 1000
+#define GENERAL_K_DIM 300
+#define GENERAL_M_DIM 700
+
+// Upper limit of default work group size of 1D kernels (without tuning).
+#define DEFAULT_MAX_LOCAL_SIZE 256
+
+// Sgemm_tiled: size of square tiles in local memory, size of C block computed by one work item (per dimension),
+// number of values copied at once into local memory and unroll factor of the loop over tile.
+// TILE_SIZE must be divisible by WORK_PER_THREAD and VECTOR_WIDTH (1, 2, 4, 8 or 16).
+// These are defaults, tuned values are passed with -D build options.
+#ifndef TILE_SIZE
+#define TILE_SIZE 32
+#endif
+#ifndef WORK_PER_THREAD
+#define WORK_PER_THREAD 4
+#endif
+#ifndef VECTOR_WIDTH
+#define VECTOR_WIDTH 4
+#endif
+#ifndef UNROLL
+#define UNROLL 1
+#endif
+
+// Skinny shapes: C with at most SKINNY_MAX_DIM columns (Sgemm_tall, 1 column is SGEMV) or rows (Sgemm_wide)
+// is computed with reductions over K instead of tiles. SKINNY_DIM (columns or rows of C) is passed with -D build option.
+// Sgemm_tall: work items reducing one row of A (power of 2). Sgemm_wide: columns of C per work group
+// and slices of K reduced in local memory (power of 2).
+#define SKINNY_MAX_DIM 8
+#ifndef SKINNY_DIM
+#define SKINNY_DIM 1
+#endif
+#ifndef SKINNY_LOCAL_SIZE
+#define SKINNY_LOCAL_SIZE 128
+#endif
+#ifndef WIDE_COLUMNS
+#define WIDE_COLUMNS 32
+#endif
+#ifndef WIDE_SPLIT_K
+#define WIDE_SPLIT_K 8
+#endif
+
+// Sgemm_general: op(A) and op(B), 1 means transposed matrix. Passed with -D build options.
+#ifndef TRANS_A
+#define TRANS_A 0
+#endif
+#ifndef TRANS_B
+#define TRANS_B 0
+#endif
+
+// Fused epilogue of Sgemm_general, applied in this order to alpha * op(A) * op(B) + beta * C before it's stored:
+// EPILOGUE_BIAS adds bias vector (BIAS_COLUMN: one value per column of C, BIAS_ROW: per row),
+// EPILOGUE_ACTIVATION applies ReLU or GELU and EPILOGUE_RESIDUAL 1 adds residual matrix. Passed with -D build options.
+#define BIAS_NONE 0
+#define BIAS_COLUMN 1
+#define BIAS_ROW 2
+#define ACTIVATION_NONE 0
+#define ACTIVATION_RELU 1
+#define ACTIVATION_GELU 2
+#ifndef EPILOGUE_BIAS
+#define EPILOGUE_BIAS BIAS_NONE
+#endif
+#ifndef EPILOGUE_ACTIVATION
+#define EPILOGUE_ACTIVATION ACTIVATION_NONE
+#endif
+#ifndef EPILOGUE_RESIDUAL
+#define EPILOGUE_RESIDUAL 0
+#endif
+
+// Strassen-Winograd SGEMM (SGEMM.exe --strassen DEPTH): recursion stops at blocks with a dimension
+// smaller than STRASSEN_MIN_DIM (cutoff), they are multiplied by Sgemm_general.
+// Quadrant additions (Sgeam) run in square work groups of GEAM_TILE_SIZE.
+#define STRASSEN_MIN_DIM 256
+#ifndef GEAM_TILE_SIZE
+#define GEAM_TILE_SIZE 16
+#endif
+
+// Blocked LU and Cholesky (SGEMM.exe --factor): columns of a panel factorized on host (staged in local memory
+// of TRSM kernels), work items of TRSM work groups and size of square tiles of Syrk_lower.
+#ifndef FACTOR_BLOCK
+#define FACTOR_BLOCK 64
+#endif
+#ifndef FACTOR_LOCAL_SIZE
+#define FACTOR_LOCAL_SIZE 64
+#endif
+#ifndef FACTOR_TILE
+#define FACTOR_TILE 16
+#endif
+
+// Transpose (repack of B for Sgemm_local_transposed and Sgemm_general with TRANS_B): size of square tiles.
+#ifndef TRANSPOSE_TILE_SIZE
+#define TRANSPOSE_TILE_SIZE 16
+#endif
+
+// Sgemm_batched: size of square blocks of C computed by one work group of a batch entry.
+// Host builds the kernel with 8 for matrices up to 8 x 8, so work groups of tiny matrices aren't mostly idle.
+#ifndef BATCH_TILE_SIZE
+#define BATCH_TILE_SIZE 16
+#endif
+
+// Quantized int8 GEMM: size of square blocks of C computed by one work group and number of values of K
+// staged in local memory at once (multiple of 4).
+#ifndef QUANT_TILE_SIZE
+#define QUANT_TILE_SIZE 16
+#endif
+#ifndef QUANT_TILE_K
+#define QUANT_TILE_K 64
+#endif
+// Largest K with exact int32 dot products, every product of values minus zero points is at most 255^2.
+#define QUANT_MAX_K (2147483647 / (255 * 255))
+
+// Sparse A in CSR format (SGEMM.exe --sparse): work items of a work group computing one row of C,
+// non-zero values of the row staged in local memory at once, work groups per compute unit
+// and the highest density of A which the dispatcher multiplies as sparse.
+#ifndef SPARSE_LOCAL_SIZE
+#define SPARSE_LOCAL_SIZE 128
+#endif
+#ifndef SPARSE_CHUNK
+#define SPARSE_CHUNK 256
+#endif
+#define SPARSE_GROUPS_PER_COMPUTE_UNIT 4
+#define SPARSE_MAX_DENSITY 0.1
+
+// Out-of-core SGEMM: number of A and B panels in flight on the device.
+// 2 is double buffering, upload of the next panels overlaps the kernel of the current ones.
+#ifndef OUT_OF_CORE_RING_SIZE
+#define OUT_OF_CORE_RING_SIZE 2
+#endif
+
+// SGEMM session (SGEMM.exe --session BATCHES): batches of A in flight, each has its own buffers of A and C.
+#ifndef SESSION_SLOTS
+#define SESSION_SLOTS 2
+#endif
+
+// Multi-device SGEMM: size of square matrices used to measure throughput of every device.
+#define MULTI_DEVICE_CALIBRATION_DIM 512
+
+// Zero-copy SGEMM (SGEMM.exe --zero-copy): alignment of host arrays used with CL_MEM_USE_HOST_PTR (page)
+// and multiple of their size (cache line), so drivers of devices sharing memory with host don't copy them.
+#define ZERO_COPY_ALIGNMENT 4096
+#define ZERO_COPY_SIZE_MULTIPLE 64
+
+// Benchmark (SGEMM.exe --benchmark): default runs before and measured runs of every variant and output files.
+#define BENCHMARK_WARMUP 1
+#define BENCHMARK_REPEATS 5
+#define BENCHMARK_JSON "sgemm_benchmark.json"
+#define BENCHMARK_CSV "sgemm_benchmark.csv"
+
+// Freivalds' verification (SGEMM.exe --verify TRIALS): work items reducing one row of a matrix (power of 2)
+// and default allowed difference of C * r and A * (B * r) relative to |A| * (|B| * |r|).
+#ifndef REDUCTION_LOCAL_SIZE
+#define REDUCTION_LOCAL_SIZE 128
+#endif
+#define FREIVALDS_TOLERANCE 1e-5f
+
+// Auto-tuning (SGEMM.exe --tune): file with the best parameters per device and number of runs of every candidate.
+#define TUNING_FILE "sgemm_tuning.txt"
+#define TUNING_REPEATS 3
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+// Kernel source of an example. It's embedded into the executable at build time by tools/embed_kernel.py
+// (<name>.embedded.h with embeddedKernelSource), so the host doesn't depend on its working directory.
+// When environment variable KERNEL_SOURCE_DIR is set, the file is read from that directory instead,
+// so kernels can be changed without rebuilding the host. Its local includes are inlined the same way
+// as by embed_kernel.py, the result doesn't depend on include paths of the OpenCL compiler.
+// SPIR-V compiled offline is looked up next to the executable (KernelILPath) and isn't used with
+// KERNEL_SOURCE_DIR, it was compiled from the built-in source, not from the overriding one.
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define KERNEL_SOURCE_DIR_VARIABLE "KERNEL_SOURCE_DIR"
+
+inline std::string InlineIncludes(const std::string& directory, const std::string& fileName, std::set<std::string>& included)
+{
+	std::string path = directory + "/" + fileName;
+	if (!included.insert(path).second)
+	{
+		return "";
+	}
+
+	std::ifstream file(path);
+	if (!file)
+	{
+		throw std::runtime_error("Kernel source " + path + " can't be read!");
+	}
+
+	std::string text;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		size_t start = line.find_first_not_of(" \t");
+		std::string directive = start == std::string::npos ? "" : line.substr(start);
+		size_t open = directive.find('"');
+		size_t close = directive.rfind('"');
+		if (directive.compare(0, 8, "#include") == 0 && open != std::string::npos && close > open)
+		{
+			text += InlineIncludes(directory, directive.substr(open + 1, close - open - 1), included);
+		}
+		else if (directive.compare(0, 12, "#pragma once") != 0)
+		{
+			text += line + "\n";
+		}
+	}
+	return text;
+}
+
+// Directory of KERNEL_SOURCE_DIR, NULL when the built-in source is used.
+inline const char* KernelSourceOverride()
+{
+	const char* directory = std::getenv(KERNEL_SOURCE_DIR_VARIABLE);
+	return directory == NULL || *directory == '\0' ? NULL : directory;
+}
+
+inline std::string LoadKernelSource(const char* fileName, const char* embedded)
+{
+	const char* directory = KernelSourceOverride();
+	if (directory == NULL)
+	{
+		return embedded;
+	}
+
+	std::set<std::string> included;
+	return InlineIncludes(directory, fileName, included);
+}
+
+// Directory of the executable with a trailing separator, empty (the working directory) when it can't be found.
+inline std::string ExecutableDirectory()
+{
+	std::string path;
+#ifdef _WIN32
+	char* program = NULL;
+	if (_get_pgmptr(&program) == 0 && program != NULL)
+	{
+		path = program;
+	}
+#else
+	char program[4096];
+	ssize_t length = readlink("/proc/self/exe", program, sizeof(program) - 1);
+	if (length > 0)
+	{
+		path.assign(program, length);
+	}
+#endif
+	size_t separator = path.find_last_of("/\\");
+	return separator == std::string::npos ? "" : path.substr(0, separator + 1);
+}
+
+// Path of SPIR-V fileName for BuildProgramCached, empty when KERNEL_SOURCE_DIR overrides the source.
+inline std::string KernelILPath(const char* fileName)
+{
+	return KernelSourceOverride() != NULL ? "" : ExecutableDirectory() + fileName;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+// On-disk cache of built OpenCL programs shared by the C++ examples. Host has to include opencl.hpp
+// with CL_HPP_ENABLE_EXCEPTIONS before this header.
+// Binary of every built program is saved into the working directory as PROGRAM_CACHE_PREFIX<hash>.clbin,
+// where hash is 64-bit FNV-1a of source, SPIR-V used instead of it (if any), build options, device name
+// and driver version. Source has to be self-contained (see KernelSource.h), changes of files it includes
+// wouldn't change the hash.
+// The next run with the same key loads it with clCreateProgramWithBinary and skips compilation of the source.
+// A file which doesn't load (other driver, damaged file) is rebuilt from source and overwritten.
+// Programs which aren't cached yet are built from SPIR-V compiled offline when the device takes it, otherwise from source.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifndef PROGRAM_CACHE_PREFIX
+#define PROGRAM_CACHE_PREFIX "program-"
+#endif
+
+inline uint64_t Fnv1a(const std::string& text, uint64_t hash = 14695981039346656037ull)
+{
+	for (unsigned char c : text)
+	{
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+inline std::string ProgramCacheFile(const cl::Device& device, const std::string& source, const std::string& il,
+	const std::string& options)
+{
+	// Parts are separated by a zero, so moving text from one to the other changes the hash.
+	const std::string parts[] = { source, il, options,
+		device.getInfo<CL_DEVICE_NAME>(), device.getInfo<CL_DRIVER_VERSION>() };
+	uint64_t hash = 14695981039346656037ull;
+	for (const std::string& part : parts)
+	{
+		hash = Fnv1a(part, hash);
+		hash = Fnv1a(std::string(1, '\0'), hash);
+	}
+
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+	return std::string(PROGRAM_CACHE_PREFIX) + name + ".clbin";
+}
+
+// SPIR-V compiled offline by tools/compile_spirv.py. CL_DEVICE_IL_VERSION and clCreateProgramWithIL are OpenCL 2.1
+// (cl_khr_il_program before), the examples target 2.0, so the query goes through the C API and the function
+// is looked up on the platform of the device under both names.
+#ifndef CL_DEVICE_IL_VERSION
+#define CL_DEVICE_IL_VERSION 0x105B
+#endif
+
+inline bool SupportsSpirV(const cl::Device& device)
+{
+	size_t size = 0;
+	if (clGetDeviceInfo(device(), CL_DEVICE_IL_VERSION, 0, NULL, &size) != CL_SUCCESS || size == 0)
+	{
+		return false;
+	}
+	std::string versions(size, '\0');
+	clGetDeviceInfo(device(), CL_DEVICE_IL_VERSION, size, &versions[0], NULL);
+	return versions.find("SPIR-V") != std::string::npos;
+}
+
+// Content of ilFileName, empty when there is no such file or the device doesn't take SPIR-V.
+inline std::string ReadIL(const cl::Device& device, const std::string& ilFileName)
+{
+	std::ifstream file(ilFileName, std::ios::binary);
+	if (ilFileName.empty() || !file || !SupportsSpirV(device))
+	{
+		return "";
+	}
+	return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+// Empty program when the platform doesn't have clCreateProgramWithIL.
+inline cl::Program CreateProgramFromIL(cl::Context& context, const cl::Device& device, const std::string& il)
+{
+	typedef cl_program(CL_API_CALL* CreateProgramWithIL)(cl_context, const void*, size_t, cl_int*);
+
+	cl_platform_id platform = device.getInfo<CL_DEVICE_PLATFORM>();
+	CreateProgramWithIL create = (CreateProgramWithIL)clGetExtensionFunctionAddressForPlatform(platform, "clCreateProgramWithIL");
+	if (!create)
+	{
+		create = (CreateProgramWithIL)clGetExtensionFunctionAddressForPlatform(platform, "clCreateProgramWithILKHR");
+	}
+	if (!create)
+	{
+		return cl::Program();
+	}
+
+	cl_int err = CL_SUCCESS;
+	cl_program program = create(context(), il.data(), il.size(), &err);
+	if (err != CL_SUCCESS)
+	{
+		throw cl::Error(err, "clCreateProgramWithIL");
+	}
+	return cl::Program(program);
+}
+
+enum ProgramOrigin
+{
+	ProgramFromBinary,
+	ProgramFromIL,
+	ProgramFromSource
+};
+
+// Builds program for device with options: from its binary in the cache, from SPIR-V in ilFileName
+// (only options which aren't preprocessor definitions apply to it) or from source, whichever works first.
+// program is assigned before every build, so build log of a failed source build can be read from it.
+inline ProgramOrigin BuildProgramCached(cl::Program& program, cl::Context& context, cl::Device& device,
+	const std::string& source, const std::string& options = "", const std::string& ilFileName = "")
+{
+	// Binary built from SPIR-V is only valid for the same SPIR-V, so it is part of the key.
+	std::string il = ReadIL(device, ilFileName);
+	std::string fileName = ProgramCacheFile(device, source, il, options);
+
+	std::ifstream file(fileName, std::ios::binary);
+	if (file)
+	{
+		std::vector<unsigned char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		try
+		{
+			program = cl::Program(context, { device }, cl::Program::Binaries{ binary });
+			program.build(device, options.c_str());
+			return ProgramFromBinary;
+		}
+		catch (cl::Error&)
+		{
+		}
+	}
+
+	ProgramOrigin origin = ProgramFromSource;
+	try
+	{
+		program = il.empty() ? cl::Program() : CreateProgramFromIL(context, device, il);
+		if (program())
+		{
+			program.build(device, options.c_str());
+			origin = ProgramFromIL;
+		}
+	}
+	catch (cl::Error&)
+	{
+		// SPIR-V which the driver rejects, source still can be built.
+	}
+	if (origin == ProgramFromSource)
+	{
+		program = cl::Program(context, source);
+		program.build(device, options.c_str());
+	}
+
+	// Program has a binary per device of the context, only the built one is saved.
+	// Failed write only means the next run compiles again.
+	std::vector<cl::Device> devices = program.getInfo<CL_PROGRAM_DEVICES>();
+	std::vector<std::vector<unsigned char>> binaries = program.getInfo<CL_PROGRAM_BINARIES>();
+	for (size_t i = 0; i < devices.size() && i < binaries.size(); i++)
+	{
+		if (devices[i]() == device() && !binaries[i].empty())
+		{
+			std::ofstream output(fileName, std::ios::binary | std::ios::trunc);
+			output.write((const char*)binaries[i].data(), binaries[i].size());
+		}
+	}
+	return origin;
+}
@@ -0,0 +1,78 @@
+import os
+import shutil
+import subprocess
+import sys
+
+# Offline compilation of OpenCL C kernels to SPIR-V, run as pre-build event of the examples:
+#     python compile_spirv.py [--clang PATH] [--llvm-spirv PATH] FILE.cl [FILE.cl ...]
+# Every FILE.cl is compiled by clang into LLVM bitcode for spir64 and translated by llvm-spirv into FILE.spv
+# next to it, headers are searched in the directory of FILE.cl. Kernel compile errors fail the build.
+# IL is optimized with -O2, drivers optimize OpenCL C by default and some of them optimize IL less.
+# Without clang or llvm-spirv nothing is compiled and hosts build their programs from source. SPIR-V which
+# can't be regenerated is deleted, so hosts never load IL of an older version of the kernels.
+
+CL_STD = 'CL2.0'
+
+def find_tool(argv, option, name):
+	if option in argv:
+		i = argv.index(option)
+		path = argv[i + 1]
+		del argv[i:i + 2]
+		return path
+	return shutil.which(name)
+
+def spirv_file(source):
+	return os.path.splitext(source)[0] + '.spv'
+
+def remove_stale(source):
+	spirv = spirv_file(source)
+	if os.path.exists(spirv):
+		os.remove(spirv)
+		print(f'{spirv} removed')
+
+def compile_file(clang, llvm_spirv, source):
+	bitcode = os.path.splitext(source)[0] + '.bc'
+	spirv = spirv_file(source)
+
+	# Up to date SPIR-V is kept, included headers are compared too.
+	directory = os.path.dirname(os.path.abspath(source))
+	headers = [os.path.join(directory, f) for f in os.listdir(directory) if f.endswith('.h')]
+	if os.path.exists(spirv) and all(os.path.getmtime(f) <= os.path.getmtime(spirv) for f in [source] + headers):
+		print(f'{spirv} is up to date')
+		return True
+
+	compile = [clang, '-c', '-x', 'cl', f'-cl-std={CL_STD}', '-Xclang', '-finclude-default-header',
+		'-target', 'spir64', '-O2', '-emit-llvm', '-I', directory, '-o', bitcode, source]
+	translate = [llvm_spirv, bitcode, '-o', spirv]
+	try:
+		for command in (compile, translate):
+			if subprocess.call(command) != 0:
+				print(f'error: {" ".join(command)} failed', file=sys.stderr)
+				remove_stale(source)
+				return False
+	finally:
+		if os.path.exists(bitcode):
+			os.remove(bitcode)
+
+	print(f'{source} -> {spirv}')
+	return True
+
+def main(argv):
+	clang = find_tool(argv, '--clang', 'clang')
+	llvm_spirv = find_tool(argv, '--llvm-spirv', 'llvm-spirv')
+	sources = argv[1:]
+	if not sources:
+		print('usage: compile_spirv.py [--clang PATH] [--llvm-spirv PATH] FILE.cl [FILE.cl ...]', file=sys.stderr)
+		return 2
+
+	if not clang or not llvm_spirv:
+		print('warning: clang or llvm-spirv not found, kernels will be compiled from source at runtime')
+		for source in sources:
+			remove_stale(source)
+		return 0
+
+	failed = [source for source in sources if not compile_file(clang, llvm_spirv, source)]
+	return 1 if failed else 0
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))
@@ -0,0 +1,60 @@
+import os
+import re
+import sys
+
+# Embeds OpenCL C kernel source into the host executable, run as pre-build event of the examples:
+#     python embed_kernel.py FILE.cl OUTPUT.h
+# Local includes (#include "file.h", searched next to the including file) are inlined once each, so the source
+# builds without include paths. OUTPUT.h defines embeddedKernelSource as a zero-terminated byte array
+# (MSVC limits string literals to 64 KB) and is rewritten only when its content changes.
+
+INCLUDE = re.compile(r'^\s*#\s*include\s+"([^"]+)"')
+PRAGMA_ONCE = re.compile(r'^\s*#\s*pragma\s+once\b')
+
+def inline_includes(path, included):
+	path = os.path.abspath(path)
+	if path in included:
+		return ''
+	included.add(path)
+
+	lines = []
+	with open(path, encoding='utf-8') as file:
+		for line in file:
+			match = INCLUDE.match(line)
+			if match:
+				lines.append(inline_includes(os.path.join(os.path.dirname(path), match.group(1)), included))
+			elif not PRAGMA_ONCE.match(line):
+				lines.append(line)
+	text = ''.join(lines)
+	return text if text.endswith('\n') else text + '\n'
+
+def generate(source, output):
+	data = inline_includes(source, set()).encode('utf-8') + b'\0'
+	rows = [', '.join(f'0x{byte:02x}' for byte in data[i:i + 16]) for i in range(0, len(data), 16)]
+	return (f'// Generated by tools/embed_kernel.py from {os.path.basename(source)}, do not edit.\n'
+		'#pragma once\n'
+		'\n'
+		'static const char embeddedKernelSource[] = {\n'
+		+ ',\n'.join('\t' + row for row in rows) + '\n'
+		'};\n')
+
+def main(argv):
+	if len(argv) != 3:
+		print('usage: embed_kernel.py FILE.cl OUTPUT.h', file=sys.stderr)
+		return 2
+
+	source, output = argv[1], argv[2]
+	header = generate(source, output)
+	if os.path.exists(output):
+		with open(output, encoding='utf-8') as file:
+			if file.read() == header:
+				print(f'{output} is up to date')
+				return 0
+
+	with open(output, 'w', encoding='utf-8', newline='\n') as file:
+		file.write(header)
+	print(f'{source} -> {output}')
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))